@@ -0,0 +1,186 @@
+#include "benchmarks.h"
+
+#include <iostream>
+#include <cstdint>
+#include <iomanip>
+#include <algorithm>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d.hpp>
+
+#include "frame.h"
+#include "hamming_matcher.h"
+#include "calibrator.h"
+#include "ransac.h"
+
+namespace camerascalib {
+
+static const int bench_runs = 3;   // best of, per size
+
+// Train descriptors and query descriptors that are shuffled copies with a
+// few bits flipped, plus a share of unrelated ones, like two overlapping views
+static void make_descriptors(int count, cv::RNG& rng, cv::Mat& query, cv::Mat& train)
+{
+    train.create(count, 32, CV_8U);
+    rng.fill(train, cv::RNG::UNIFORM, cv::Scalar(0), cv::Scalar(256));
+    query.create(count, 32, CV_8U);
+    for (int i = 0; i < count; i++)
+    {
+        uchar* row = query.ptr(i);
+        if (rng.uniform(0, 5) == 0) {
+            for (int b = 0; b < 32; b++) {
+                row[b] = (uchar)rng.uniform(0, 256);
+            }
+            continue;
+        }
+        train.row(rng.uniform(0, count)).copyTo(query.row(i));
+        for (int flip = 0; flip < 20; flip++) {
+            int bit = rng.uniform(0, 256);
+            row[bit / 8] ^= (uchar)(1 << (bit % 8));
+        }
+    }
+}
+
+static void bf_ratio_match(const cv::DescriptorMatcher& matcher, const cv::Mat& query,
+    const cv::Mat& train, std::vector<cv::DMatch>& matches)
+{
+    std::vector<std::vector<cv::DMatch>> knn;
+    matcher.knnMatch(query, train, knn, 2);
+    matches.clear();
+    for (const std::vector<cv::DMatch>& candidates : knn) {
+        if (candidates.size() == 2 && candidates[0].distance < 0.8f * candidates[1].distance) {
+            matches.push_back(candidates[0]);
+        }
+    }
+}
+
+int BenchMatchers()
+{
+    const int sizes[] = { 1000, 5000, 20000 };
+    cv::RNG rng(0x5eed);
+    cv::Ptr<cv::DescriptorMatcher> matcher = cv::BFMatcher::create(cv::NORM_HAMMING);
+
+    std::cout << "Ratio test matching of 256 bit descriptors, best of " << bench_runs
+        << " runs, " << cv::getNumThreads() << " threads, kernel " << HammingKernel()
+        << std::endl;
+    for (int size : sizes)
+    {
+        cv::Mat query, train;
+        make_descriptors(size, rng, query, train);
+
+        std::vector<cv::DMatch> reference, matches;
+        int64_t bf_ns = INT64_MAX, hamming_ns = INT64_MAX;
+        for (int run = 0; run < bench_runs; run++)
+        {
+            int64_t start = MonotonicNs();
+            bf_ratio_match(*matcher, query, train, reference);
+            int64_t middle = MonotonicNs();
+            HammingRatioMatch(query, train, matches);
+            int64_t end = MonotonicNs();
+            bf_ns = std::min(bf_ns, middle - start);
+            hamming_ns = std::min(hamming_ns, end - middle);
+        }
+
+        // ties may resolve to different train rows, compare by distance
+        size_t agree = 0;
+        size_t k = 0;
+        for (const cv::DMatch& match : reference) {
+            while (k < matches.size() && matches[k].queryIdx < match.queryIdx) {
+                k++;
+            }
+            if (k < matches.size() && matches[k].queryIdx == match.queryIdx &&
+                matches[k].distance == match.distance) {
+                agree++;
+            }
+        }
+        std::cout << std::fixed << std::setprecision(1) << std::setw(6) << size
+            << " keypoints: BFMatcher " << bf_ns / 1e6 << " ms, Hamming " << hamming_ns / 1e6
+            << " ms (x" << (double)bf_ns / std::max<int64_t>(1, hamming_ns) << "), "
+            << matches.size() << " matches, " << agree << "/" << reference.size()
+            << " agree" << std::endl;
+    }
+    return 0;
+}
+
+int BenchDetectors(FrameSetPairer& pairer, const DetectorBenchSettings& settings)
+{
+    // the same gray pairs for every mode
+    std::vector<std::vector<cv::Mat>> pairs;
+    std::vector<Frame> frames;
+    while ((int)pairs.size() < settings.pairs)
+    {
+        if (!pairer.Next(frames, 100)) {
+            if (pairer.Finished()) {
+                break;
+            }
+            continue;
+        }
+        std::vector<cv::Mat> pair(2);
+        for (int i = 0; i < 2; i++) {
+            cv::Mat image;
+            if (settings.luma) {
+                ToLuma(MatchingBranch(frames[i]), image);
+            }
+            else {
+                ToBgr(MatchingBranch(frames[i]), image);
+            }
+            ToGray(image, image);
+            image.copyTo(pair[i]);
+        }
+        pairs.push_back(pair);
+    }
+    if (pairs.empty()) {
+        std::cerr << "No pairs to benchmark on" << std::endl;
+        return -1;
+    }
+
+    std::cout << "Match modes over " << pairs.size() << " pairs at " << settings.image_size
+        << ", per pair:" << std::endl;
+    for (int mode = 0; mode < match_modes; mode++)
+    {
+        cv::Ptr<cv::Feature2D> detector = CreateDetector(mode, settings.detector);
+        cv::Ptr<cv::DescriptorMatcher> matcher = cv::BFMatcher::create(detector->defaultNorm());
+        int64_t detect_ns = 0, match_ns = 0;
+        size_t keypoints = 0;
+        Correspondences points;
+        for (const std::vector<cv::Mat>& pair : pairs)
+        {
+            std::vector<cv::KeyPoint> found[2];
+            cv::Mat descriptors[2];
+            int64_t start = MonotonicNs();
+            for (int i = 0; i < 2; i++) {
+                detector->detectAndCompute(pair[i], cv::noArray(), found[i], descriptors[i]);
+                keypoints += found[i].size();
+            }
+            int64_t middle = MonotonicNs();
+            std::vector<cv::DMatch> matches;
+            RatioMatch(*matcher, descriptors[0], descriptors[1], matches);
+            match_ns += MonotonicNs() - middle;
+            detect_ns += middle - start;
+            for (const cv::DMatch& match : matches) {
+                points.Push(found[0][match.queryIdx].pt, found[1][match.trainIdx].pt);
+            }
+        }
+
+        std::vector<uchar> inliers;
+        cv::Matx33d transform;
+        bool estimated = FindHomographyRansac(points, RansacSettings(), transform, &inliers);
+        size_t n = pairs.size();
+        std::cout << std::fixed << std::setprecision(1) << std::setw(6) << MatchModeName(mode)
+            << ": " << keypoints / (2 * n) << " keypoints, detect " << detect_ns / 1e6 / n
+            << " ms, match " << match_ns / 1e6 / n << " ms, " << points.Size() / n
+            << " matches, inliers " << std::setprecision(2)
+            << (estimated ? (double)cv::countNonZero(inliers) / points.Size() : 0.0);
+        if (!estimated) {
+            std::cout << ", no transform";
+        }
+        else if (settings.has_truth) {
+            std::cout << ", error " << HomographyError(transform, settings.truth, settings.image_size)
+                << " px";
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
+
+} // namespace camerascalib
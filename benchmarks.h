@@ -0,0 +1,34 @@
+#ifndef CAMERASCALIB_BENCHMARKS_H
+#define CAMERASCALIB_BENCHMARKS_H
+
+#include <opencv2/core/core.hpp>
+
+#include "matching.h"
+#include "capture_thread.h"
+
+namespace camerascalib {
+
+// Times HammingRatioMatch against cv::BFMatcher with the same ratio test on
+// random ORB-like descriptors at 1k, 5k and 20k keypoints per image and
+// prints the timings and how far the matches agree. 0 on success.
+int BenchMatchers();
+
+struct DetectorBenchSettings
+{
+    cv::Size image_size;        // of the matching branch
+    bool luma = false;
+    int pairs = 50;             // taken from the source, then run through every mode
+    DetectorSettings detector;  // everything but the mode
+    bool has_truth = false;
+    cv::Matx33d truth;          // camera 0 to camera 1, at image_size
+};
+
+// Runs every match mode over the same pairs from pairer and prints, per
+// mode, detection and matching time per pair, matches, the RANSAC inlier
+// ratio over all of them and, with a true transform, the error of the
+// estimate in pixels. 0 on success.
+int BenchDetectors(FrameSetPairer& pairer, const DetectorBenchSettings& settings);
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_BENCHMARKS_H
@@ -0,0 +1,299 @@
+#include "calib_pipeline.h"
+
+#ifdef WITH_CUDA
+#include <opencv2/cudaimgproc.hpp>
+#endif
+
+namespace camerascalib {
+
+#ifdef WITH_CUDA
+
+// Upload a frame and convert it to BGR on the GPU where possible, so the CPU
+// never touches the pixels of a BGRx or gray capture
+static void upload_bgr(const Frame& frame, cv::cuda::GpuMat& staging, cv::cuda::GpuMat& bgr)
+{
+    switch (frame.format)
+    {
+    case PIXEL_FORMAT_BGR:
+        bgr.upload(frame.image);
+        break;
+    case PIXEL_FORMAT_BGRX:
+        staging.upload(frame.image);
+        cv::cuda::cvtColor(staging, bgr, cv::COLOR_BGRA2BGR);
+        break;
+    case PIXEL_FORMAT_GRAY:
+        staging.upload(frame.image);
+        cv::cuda::cvtColor(staging, bgr, cv::COLOR_GRAY2BGR);
+        break;
+    default:
+        {
+            // no CUDA NV12 conversion in OpenCV, do it in one pass on the CPU
+            cv::Mat host;
+            ToBgr(frame, host);
+            bgr.upload(host);
+        }
+        break;
+    }
+}
+#endif
+
+// A frame as CPU backends take it without a conversion: BGR, BGRx and gray
+// frames are shared as they are, NV12 gives a view of its Y plane
+static void host_view(const Frame& frame, bool luma, cv::Mat& image)
+{
+    if (luma || frame.format == PIXEL_FORMAT_NV12) {
+        ToLuma(frame, image);
+    }
+    else {
+        image = frame.image;
+    }
+}
+
+CalibPipeline::CalibPipeline(const Settings& settings, FrameSetPairer& pairer,
+    const std::shared_ptr<Calibrator>& calib, RecordWriter* recorder)
+    : pairer_(pairer)
+    , calib_(calib)
+    , recorder_(recorder)
+    , settings_(settings)
+    , gate_(settings.novelty)
+    , pool_(settings.depth * 2 + 2)
+    , free_(pool_.size())
+    , prepared_(settings.depth)
+    , calibrated_(settings.depth)
+    , commands_(16)
+    , stop_(false)
+    , prepare_done_(false)
+    , calibrate_done_(false)
+{
+    for (PairWork& work : pool_) {
+        // GPU backends calibrate camera pairs, host buffers grow with the rig
+        work.images.resize(2);
+        work.full_images.resize(2);
+        work.cuda_frames.resize(2);
+        work.cuda_images.resize(2);
+        free_.TryPush(&work);
+    }
+}
+
+CalibPipeline::~CalibPipeline()
+{
+    Stop();
+}
+
+void CalibPipeline::Start()
+{
+    stop_ = false;
+    prepare_thread_ = std::thread(&CalibPipeline::Prepare, this);
+    calibrate_thread_ = std::thread(&CalibPipeline::Calibrate, this);
+}
+
+void CalibPipeline::Stop()
+{
+    stop_ = true;
+    if (prepare_thread_.joinable()) {
+        prepare_thread_.join();
+    }
+    if (calibrate_thread_.joinable()) {
+        calibrate_thread_.join();
+    }
+}
+
+PairWork* CalibPipeline::Next(int timeout_ms)
+{
+    PairWork* work = nullptr;
+    if (!calibrated_.Pop(work, stop_, timeout_ms)) {
+        return nullptr;
+    }
+    return work;
+}
+
+void CalibPipeline::Release(PairWork* work)
+{
+    if (work) {
+        free_.TryPush(work);
+    }
+}
+
+void CalibPipeline::Command(int key)
+{
+    commands_.TryPush(key);
+}
+
+bool CalibPipeline::Finished() const
+{
+    return calibrate_done_ && calibrated_.Empty();
+}
+
+void CalibPipeline::Prepare()
+{
+    while (!stop_)
+    {
+        PairWork* work = nullptr;
+        if (!free_.Pop(work, stop_, 100)) {
+            continue;
+        }
+        while (!stop_ && !pairer_.Next(work->frames, 100)) {
+            if (pairer_.Finished()) {
+                prepare_done_ = true;
+                return;
+            }
+        }
+        if (stop_) {
+            break;
+        }
+        int64_t taken = MonotonicNs();
+        for (const Frame& frame : work->frames) {
+            timers_.Record(STAGE_CAPTURE, taken - frame.arrival);
+        }
+        if (recorder_) {
+            recorder_->Append(work->frames);
+        }
+        work->keyframe = gate_.Accept(work->frames);
+
+        if (calib_->OnGpu()) {
+            ScopedLatency timer(&timers_, STAGE_UPLOAD);
+            PrepareDevice(work);
+        }
+        else {
+            ScopedLatency timer(&timers_, STAGE_CONVERT);
+            PrepareHost(work);
+        }
+        prepared_.Push(work, stop_);
+    }
+    prepare_done_ = true;
+}
+
+// CPU backends read host images directly, nothing is uploaded, and in the
+// layout captured, so the only colour conversion is for the matches view
+void CalibPipeline::PrepareHost(PairWork* work)
+{
+    size_t cameras = work->frames.size();
+    work->images.resize(cameras);
+    work->full_images.resize(cameras);
+    work->render_images.resize(cameras);
+    for (size_t i = 0; i < cameras; i++)
+    {
+        const Frame& frame = work->frames[i];
+        Frame branch = MatchingBranch(frame);
+        host_view(branch, settings_.luma, work->images[i]);
+        if (calib_->FullSizeEvaluate() && !frame.scaled.empty()) {
+            host_view(frame, settings_.luma, work->full_images[i]);
+        }
+        else {
+            work->full_images[i] = work->images[i];
+        }
+        if (settings_.render && !settings_.luma) {
+            ToBgr(branch, work->render_images[i]);
+        }
+        else {
+            work->render_images[i] = work->images[i];
+        }
+    }
+}
+
+void CalibPipeline::PrepareDevice(PairWork* work)
+{
+#ifdef WITH_CUDA
+    for (int i = 0; i < 2; i++)
+    {
+        Frame frame = MatchingBranch(work->frames[i]);
+        if (settings_.luma) {
+            // single channel all the way through, a third of the traffic
+            ToLuma(frame, work->images[i]);
+            work->cuda_images[i].upload(work->images[i]);
+        }
+        else {
+            upload_bgr(frame, work->cuda_frames[i], work->cuda_images[i]);
+            // the matches view is the only CPU consumer that needs BGR
+            if (settings_.render) {
+                ToBgr(frame, work->images[i]);
+            }
+        }
+    }
+#else
+    (void)work;
+#endif
+}
+
+void CalibPipeline::Calibrate()
+{
+    while (!stop_)
+    {
+        RunCommands();
+
+        PairWork* work = nullptr;
+        if (!prepared_.Pop(work, stop_, 10)) {
+            if (prepare_done_ && prepared_.Empty()) {
+                break;
+            }
+            continue;
+        }
+
+        uint64_t sequence = work->frames[0].sequence;
+        // a settled estimate gains nothing from more pairs
+        bool feed = work->keyframe && !calib_->Converged();
+        if (calib_->OnGpu())
+        {
+            if (feed) {
+                ScopedLatency timer(&timers_, STAGE_FEED);
+                calib_->Feed(work->cuda_images, sequence);
+            }
+            if (settings_.render) {
+                ScopedLatency timer(&timers_, STAGE_MATCHES);
+                calib_->Matches(work->images, sequence, work->matches_image);
+            }
+            {
+                ScopedLatency timer(&timers_, STAGE_EVALUATE);
+                calib_->Evaluate(work->cuda_images, work->psnr, work->mssim, work->stitched_image);
+            }
+            if (settings_.render) {
+                ScopedLatency timer(&timers_, STAGE_DOWNLOAD);
+                work->stitched_image.download(work->visual_stitching);
+            }
+        }
+        else
+        {
+            if (feed) {
+                ScopedLatency timer(&timers_, STAGE_FEED);
+                calib_->Feed(work->images, sequence);
+            }
+            if (settings_.render) {
+                {
+                    ScopedLatency timer(&timers_, STAGE_MATCHES);
+                    calib_->Matches(work->render_images, sequence, work->matches_image);
+                }
+                ScopedLatency timer(&timers_, STAGE_EVALUATE);
+                calib_->Evaluate(work->full_images, work->psnr, work->mssim,
+                    work->visual_stitching);
+            }
+            else {
+                ScopedLatency timer(&timers_, STAGE_EVALUATE);
+                calib_->Evaluate(work->full_images, work->psnr, work->mssim, cv::noArray());
+            }
+        }
+        work->convergence = calib_->Convergence();
+        work->converged = calib_->Converged();
+        calibrated_.Push(work, stop_);
+    }
+    RunCommands();
+    calibrate_done_ = true;
+}
+
+void CalibPipeline::RunCommands()
+{
+    int key = 0;
+    while (commands_.TryPop(key))
+    {
+        if (key == 'c') {
+            calib_->Estimate();
+        }
+        else if (key == 's') {
+            calib_->Save();
+        }
+        else if (key == 'r') {
+            calib_->Reset();
+        }
+    }
+}
+
+} // namespace camerascalib
@@ -0,0 +1,117 @@
+#ifndef CAMERASCALIB_CALIB_PIPELINE_H
+#define CAMERASCALIB_CALIB_PIPELINE_H
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/core/cuda.hpp>
+
+#include "frame.h"
+#include "calibrator.h"
+#include "keyframe_gate.h"
+#include "capture_thread.h"
+#include "recording.h"
+#include "spsc_queue.h"
+#include "latency.h"
+
+namespace camerascalib {
+
+// Everything one stereo pair (or synchronised set, for a rig) produces on its
+// way through the pipeline. The items are pooled, so buffers (host and
+// device) are reused frame to frame.
+struct PairWork
+{
+    std::vector<Frame> frames;
+    std::vector<cv::Mat> images;                // what the calibrator matches on
+    std::vector<cv::Mat> render_images;         // images in BGR for the matches view, CPU backends
+    std::vector<cv::Mat> full_images;           // capture size, for backends evaluating there
+    std::vector<cv::cuda::GpuMat> cuda_frames;  // native layout staging
+    std::vector<cv::cuda::GpuMat> cuda_images;
+    cv::Mat matches_image;
+    cv::cuda::GpuMat stitched_image;
+    cv::Mat visual_stitching;
+    bool keyframe = true;                       // new enough to be fed to the calibrator
+    double convergence = -1;                    // see Calibrator::Convergence()
+    bool converged = false;
+    double psnr = 0;
+    cv::Scalar mssim;
+};
+
+// Runs capture-to-display as a chain of stages, each on its own thread and
+// connected by bounded lock-free queues:
+//
+//   capture threads -> prepare (pair, record, keyframe gate, convert, upload for GPU backends)
+//                   -> calibrate (Feed, Matches, Evaluate, download for GPU backends)
+//                   -> caller (display, keyboard)
+//
+// so pair N+1 is prepared while pair N is calibrated and pair N-1 shown, and
+// throughput is set by the slowest stage rather than the sum of all of them.
+// The calibrator keeps state between calls and is not thread safe, so all of
+// its calls, runtime commands included, stay on the calibrate stage.
+// Every step is timed into Timers(), which the caller times its display
+// into as well.
+class CalibPipeline
+{
+public:
+    struct Settings
+    {
+        bool luma = false;      // match on the Y plane only
+        bool render = true;     // draw matches and download the preview for display
+        size_t depth = 2;       // pairs queued between two stages
+        double novelty = 2.0;   // keyframe threshold, see KeyframeGate; 0 feeds every pair
+    };
+
+    CalibPipeline(const Settings& settings, FrameSetPairer& pairer,
+        const std::shared_ptr<Calibrator>& calib, RecordWriter* recorder);
+    ~CalibPipeline();
+
+    void Start();
+    void Stop();
+
+    // Next calibrated pair, or nullptr after timeout_ms. Every pair taken
+    // must be handed back with Release().
+    PairWork* Next(int timeout_ms);
+    void Release(PairWork* work);
+
+    // Queue a runtime command ('c', 's' or 'r') for the calibrate stage
+    void Command(int key);
+
+    // True once the capture has ended and every pair has been delivered
+    bool Finished() const;
+
+    const KeyframeGate& Gate() const { return gate_; }
+    StageTimers& Timers() { return timers_; }
+
+private:
+    void Prepare();
+    void Calibrate();
+    void RunCommands();
+    void PrepareHost(PairWork* work);
+    void PrepareDevice(PairWork* work);
+
+    FrameSetPairer& pairer_;
+    std::shared_ptr<Calibrator> calib_;
+    RecordWriter* recorder_;
+    Settings settings_;
+    KeyframeGate gate_;
+    StageTimers timers_;
+
+    std::vector<PairWork> pool_;
+    SpscQueue<PairWork*> free_;
+    SpscQueue<PairWork*> prepared_;
+    SpscQueue<PairWork*> calibrated_;
+    SpscQueue<int> commands_;
+
+    std::atomic<bool> stop_;
+    std::atomic<bool> prepare_done_;
+    std::atomic<bool> calibrate_done_;
+    std::thread prepare_thread_;
+    std::thread calibrate_thread_;
+};
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_CALIB_PIPELINE_H
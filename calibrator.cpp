@@ -0,0 +1,72 @@
+#include "calibrator.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include "cpu_calibrator.h"
+#include "rig_calibrator.h"
+#ifdef WITH_CUDA
+#include "cuda_calibrator.h"
+#endif
+
+namespace camerascalib {
+
+std::shared_ptr<Calibrator> CreateCalibrator(const Calibrator::Settings& settings)
+{
+    std::shared_ptr<Calibrator> calib;
+    if (settings.cameras > 2) {
+        if (settings.backend == "cpu") {
+            calib.reset(new RigCalibrator(settings));
+        }
+    }
+    else if (settings.backend == "cpu") {
+        calib.reset(new CpuCalibrator(settings));
+    }
+#ifdef WITH_CUDA
+    else if (settings.backend == "cuda") {
+        calib.reset(new CudaCalibrator(settings));
+    }
+#endif
+    return calib;
+}
+
+cv::Matx33d ScaleHomography(const cv::Matx33d& transform, cv::Size from, cv::Size to)
+{
+    if (from == to || from.area() == 0) {
+        return transform;
+    }
+    // x_to = S x_from for both cameras, so H_to = S H_from S^-1
+    double sx = (double)to.width / from.width;
+    double sy = (double)to.height / from.height;
+    cv::Matx33d scale(sx, 0, 0, 0, sy, 0, 0, 0, 1);
+    cv::Matx33d unscale(1 / sx, 0, 0, 0, 1 / sy, 0, 0, 0, 1);
+    cv::Matx33d scaled = scale * transform * unscale;
+    return scaled * (1.0 / scaled(2, 2));
+}
+
+cv::Matx33d PixelNormalisation(cv::Size size)
+{
+    double scale = std::max(size.width, size.height) / 2.0;
+    double cx = size.width / 2.0;
+    double cy = size.height / 2.0;
+    return cv::Matx33d(1 / scale, 0, -cx / scale, 0, 1 / scale, -cy / scale, 0, 0, 1);
+}
+
+double HomographyError(const cv::Matx33d& estimated, const cv::Matx33d& truth, cv::Size size)
+{
+    const cv::Vec3d corners[] = { cv::Vec3d(0, 0, 1), cv::Vec3d(size.width, 0, 1),
+        cv::Vec3d(size.width, size.height, 1), cv::Vec3d(0, size.height, 1) };
+    double error = 0;
+    for (const cv::Vec3d& corner : corners)
+    {
+        cv::Vec3d p = estimated * corner;
+        cv::Vec3d q = truth * corner;
+        if (p[2] <= 1e-9 || q[2] <= 1e-9) {
+            return HUGE_VAL;
+        }
+        error += std::hypot(p[0] / p[2] - q[0] / q[2], p[1] / p[2] - q[1] / q[2]);
+    }
+    return error / 4;
+}
+
+} // namespace camerascalib
@@ -0,0 +1,96 @@
+#ifndef CAMERASCALIB_CALIBRATOR_H
+#define CAMERASCALIB_CALIBRATOR_H
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <opencv2/core/core.hpp>
+
+#include "descriptor_index.h"
+#include "matching.h"
+
+namespace camerascalib {
+
+// Estimates the transform between two cameras from a stream of image pairs.
+// Pairs are passed as arrays of arrays: host cv::Mat for backends running on
+// the CPU, cv::cuda::GpuMat for those running on the GPU (see OnGpu()), so
+// frames are only uploaded when the backend needs them there.
+class Calibrator
+{
+public:
+    struct Settings
+    {
+#ifdef WITH_CUDA
+        std::string backend = "cuda";
+#else
+        std::string backend = "cpu";
+#endif
+        std::string calib_file;
+        int cameras = 2;        // more makes a rig, cpu backend only
+        cv::Size image_size;    // what Feed and Matches see, the matching branch
+        cv::Size full_size;     // capture size, the saved transform is scaled to it
+        int match_mode = 0;     // see CreateDetector
+        DetectorSettings detector;
+        double tolerance = 0.5; // online estimate convergence, pixels at image_size; 0 disables it
+        IndexSettings index;    // search of the correspondence history
+        size_t max_correspondences = 20000;     // kept per camera pair, cpu backends
+        int eval_level = 0;     // Evaluate scores at 1/2^eval_level resolution
+        bool refine = false;    // refine Estimate's transform on intensities, cpu backend
+    };
+
+    virtual ~Calibrator() {}
+
+    // Whether Feed and Evaluate take device images
+    virtual bool OnGpu() const = 0;
+
+    // Whether Evaluate takes capture size images, rather than the matching
+    // branch, and scales the transform itself
+    virtual bool FullSizeEvaluate() const = 0;
+
+    // Add the correspondences of one pair. sequence identifies the pair (the
+    // sequence number of camera 0's frame), so that backends can detect and
+    // match once for Feed and Matches on the same pair.
+    virtual void Feed(cv::InputArrayOfArrays images, uint64_t sequence) = 0;
+
+    // Draw the matches of one pair, always from host images
+    virtual void Matches(const std::vector<cv::Mat>& images, uint64_t sequence,
+        cv::Mat& matches_image) = 0;
+
+    // Stitch one pair with the current transform and score how well camera 1
+    // lands on camera 0. stitched_image may be cv::noArray().
+    virtual void Evaluate(cv::InputArrayOfArrays images, double& psnr, cv::Scalar& mssim,
+        cv::OutputArray stitched_image) = 0;
+
+    // Estimate the transform from everything fed so far
+    virtual bool Estimate() = 0;
+
+    // Backends estimating online as pairs are fed report how much the last
+    // update moved the transform (corner shift in pixels, negative while
+    // there is nothing to compare) and whether it has settled, after which
+    // feeding more pairs is wasted work
+    virtual double Convergence() const { return -1; }
+    virtual bool Converged() const { return false; }
+
+    virtual bool Save() = 0;
+    virtual void Reset() = 0;
+};
+
+// Create the calibrator of settings.backend ("cpu", or "cuda" when built
+// with WITH_CUDA) for settings.cameras, or nullptr if this build has no such
+// backend or it cannot calibrate that many cameras
+std::shared_ptr<Calibrator> CreateCalibrator(const Calibrator::Settings& settings);
+
+// Express a transform estimated on images of size from on images of size to
+cv::Matx33d ScaleHomography(const cv::Matx33d& transform, cv::Size from, cv::Size to);
+
+// Pixels of an image of size to about [-1, 1], centred and scaled alike in
+// both axes, which keeps homography fits and updates well conditioned
+cv::Matx33d PixelNormalisation(cv::Size size);
+
+// Mean distance, in pixels, between the image corners mapped by two homographies
+double HomographyError(const cv::Matx33d& estimated, const cv::Matx33d& truth, cv::Size size);
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_CALIBRATOR_H
@@ -0,0 +1,133 @@
+#include "camera_source.h"
+
+#include <sstream>
+
+namespace camerascalib {
+
+static std::string create_appsink(DropPolicy policy, size_t queue_size)
+{
+    std::stringstream appsink_str;
+    switch (policy)
+    {
+    case DROP_LATEST:
+        appsink_str << "appsink drop=true max-buffers=1 sync=false ";
+        break;
+    case DROP_BOUNDED:
+        appsink_str << "appsink drop=true max-buffers=" << queue_size << " sync=false ";
+        break;
+    default:
+        // a full appsink pushes back on the camera
+        appsink_str << "appsink drop=false max-buffers=" << queue_size << " sync=false ";
+        break;
+    }
+    return appsink_str.str();
+}
+
+static std::string create_pipeline(int sensor, const CaptureSettings& settings)
+{
+    std::stringstream pipeline_str;
+    pipeline_str << "nvarguscamerasrc sensor-id=" << std::to_string(sensor) 
+        << " ! video/x-raw(memory:NVMM), width=(int)" << std::to_string(settings.size.width) 
+        << ", height=(int)" << std::to_string(settings.size.height)
+        << ", format=(string)NV12, framerate=(fraction)" << std::to_string(settings.fps)
+        << "/1 ! nvvidconv";
+    switch (settings.format)
+    {
+    case PIXEL_FORMAT_NV12:
+        pipeline_str << " ! video/x-raw, format=(string)NV12 ! ";
+        break;
+    case PIXEL_FORMAT_GRAY:
+        pipeline_str << " ! video/x-raw, format=(string)GRAY8 ! ";
+        break;
+    case PIXEL_FORMAT_BGR:
+        // nvvidconv cannot output packed BGR, this costs a CPU conversion
+        pipeline_str << " ! video/x-raw, format=(string)BGRx ! videoconvert"
+            " ! video/x-raw, format=(string)BGR ! ";
+        break;
+    default:
+        pipeline_str << " ! video/x-raw, format=(string)BGRx ! ";
+        break;
+    }
+    pipeline_str << create_appsink(settings.drop, settings.queue_size);
+
+    return pipeline_str.str();
+}
+
+LiveSource::LiveSource(const CaptureSettings& settings)
+    : settings_(settings)
+    , sequence_(0)
+    , last_timestamp_(0)
+    , dropped_(0)
+{
+}
+
+// grab() then stamp, so the timestamp is taken when the frame arrives and
+// not after it has been converted
+bool LiveSource::Read(Frame& frame)
+{
+    if (!capture_.grab()) {
+        return false;
+    }
+    frame.timestamp = MonotonicNs();
+    frame.sequence = sequence_++;
+
+    // a gap of more than one and a half periods means frames went missing
+    int64_t period = 1000000000LL / settings_.fps;
+    if (last_timestamp_ != 0) {
+        int64_t gap = frame.timestamp - last_timestamp_;
+        if (gap > period * 3 / 2) {
+            dropped_ += (unsigned long)((gap + period / 2) / period - 1);
+        }
+    }
+    last_timestamp_ = frame.timestamp;
+
+    if (!capture_.retrieve(frame.image)) {
+        return false;
+    }
+    frame.format = DetectPixelFormat(frame.image, settings_.size);
+    return true;
+}
+
+void LiveSource::Close()
+{
+    capture_.release();
+}
+
+GStreamerSource::GStreamerSource(int sensor, const CaptureSettings& settings)
+    : LiveSource(settings)
+    , sensor_(sensor)
+{
+    pipeline_ = create_pipeline(sensor_, settings_);
+}
+
+bool GStreamerSource::Open()
+{
+    return capture_.open(pipeline_, cv::CAP_GSTREAMER);
+}
+
+V4l2Source::V4l2Source(int sensor, const CaptureSettings& settings)
+    : LiveSource(settings)
+    , sensor_(sensor)
+{
+}
+
+bool V4l2Source::Open()
+{
+    if (!capture_.open(sensor_, cv::CAP_V4L2)) {
+        return false;
+    }
+    capture_.set(cv::CAP_PROP_FRAME_WIDTH, settings_.size.width);
+    capture_.set(cv::CAP_PROP_FRAME_HEIGHT, settings_.size.height);
+    capture_.set(cv::CAP_PROP_FPS, settings_.fps);
+    // driver queue: one buffer means the next grab is the freshest frame
+    capture_.set(cv::CAP_PROP_BUFFERSIZE,
+        settings_.drop == DROP_LATEST ? 1 : (double)settings_.queue_size);
+    return true;
+}
+
+std::string V4l2Source::Description() const
+{
+    return "/dev/video" + std::to_string(sensor_);
+}
+
+} // namespace camerascalib
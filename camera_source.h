@@ -0,0 +1,72 @@
+#ifndef CAMERASCALIB_CAMERA_SOURCE_H
+#define CAMERASCALIB_CAMERA_SOURCE_H
+
+#include <atomic>
+
+#include <opencv2/videoio/videoio.hpp>
+
+#include "capture_source.h"
+
+namespace camerascalib {
+
+// Common part of the cameras read through cv::VideoCapture. Frames the
+// backend drops on its own are not reported, so they are counted from gaps
+// in the arrival times instead.
+class LiveSource : public CaptureSource
+{
+public:
+    explicit LiveSource(const CaptureSettings& settings);
+
+    bool Read(Frame& frame) override;
+    void Close() override;
+
+    bool Live() const override { return true; }
+    unsigned long Dropped() const override { return dropped_; }
+
+protected:
+    CaptureSettings settings_;
+    cv::VideoCapture capture_;
+
+private:
+    uint64_t sequence_;
+    int64_t last_timestamp_;
+    std::atomic<unsigned long> dropped_;
+};
+
+// CSI camera on a Jetson, read through an nvarguscamerasrc pipeline. The
+// hardware converter hands BGRx or NV12 straight to appsink; no CPU
+// videoconvert stage runs in the pipeline. The appsink queue follows the
+// drop policy, so stale frames never pile up inside GStreamer.
+class GStreamerSource : public LiveSource
+{
+public:
+    GStreamerSource(int sensor, const CaptureSettings& settings);
+
+    bool Open() override;
+
+    PixelFormat NativeFormat() const override { return settings_.format; }
+    std::string Description() const override { return pipeline_; }
+
+private:
+    int sensor_;
+    std::string pipeline_;
+};
+
+// USB or other V4L2 camera at /dev/video<sensor>
+class V4l2Source : public LiveSource
+{
+public:
+    V4l2Source(int sensor, const CaptureSettings& settings);
+
+    bool Open() override;
+
+    PixelFormat NativeFormat() const override { return PIXEL_FORMAT_BGR; }
+    std::string Description() const override;
+
+private:
+    int sensor_;
+};
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_CAMERA_SOURCE_H
@@ -1,8 +1,10 @@
 #include <iostream>
+#include <fstream>
 #include <string>
 #include <sstream>
 #include <chrono>
 #include <atomic>
+#include <algorithm>
 #include <signal.h>
 
 #include <opencv2/core/core.hpp>
@@ -10,46 +12,115 @@
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
-#include <videostitcher/cameras_calib.h>
+#include "capture_thread.h"
+#include "capture_source.h"
+#include "synthetic_source.h"
+#include "recording.h"
+#include "calibrator.h"
+#include "calib_pipeline.h"
+#include "command_channel.h"
+#include "benchmarks.h"
 
 static std::string matches_window = "Matches";
 static std::string warping_window = "Warping";
 static int window_width = 1280;
 static int window_height = 720;
-
-static std::string create_capture (int camera, int width, int height, int fps);
+static int stats_interval = 10;  // seconds between frame drop and latency reports
 
 static void help()
 {
     std::cout << "\nThis is a calibration tool running on Jetson Nano "
-    "or Jetson Xvier NX to generate transform between two CSI-cameras.\n\n" 
+    "or Jetson Xvier NX to generate the transforms between the cameras of a rig:\n"
+    "a stereo pair or more cameras, captured from CSI (gstreamer) or V4L2,\n"
+    "replayed from a recording, or synthesised for testing.\n\n" 
     "./camerascalib [--Options]\n\n"
     "OPTIONS:\n"
     "\t-h,--help            Prints this message\n"
     "\t--width              Capture width [Default = 1920]\n"
     "\t--height             Capture height [Default = 1080]\n"
     "\t--fps                Frames per second [Default = 30]\n"
+    "\t--format             Pixel format taken from the capture: bgrx, nv12, gray or bgr\n"
+    "\t                     (bgr adds a CPU conversion to the pipeline) [Default = bgrx]\n"
+    "\t--match-scale        Run Feed/Matches on frames downscaled by this factor, e.g. 0.5, cpu\n"
+    "\t                     backends; the transform is saved at capture size [Default = 1]\n"
+    "\t--luma               Calibrate on the Y plane only, capturing NV12 unless --format=gray\n"
     "\t--out                Output calibration (path and) filename [Default = cameras.xml]\n"
+    "\t--backend            Calibrator: cuda (videostitcher on the GPU) or cpu (no GPU needed,\n"
+    "\t                     frames are not uploaded) [Default = cuda when built with CUDA, else cpu]\n"
+    "\t--source             Capture source: gstreamer, v4l2, replay or synthetic [Default = gstreamer]\n"
+    "\t--sensors            Sensor ids (or /dev/video numbers) of the cameras; more than two\n"
+    "\t                     calibrate the whole rig into one file (cpu backend) [Default = 0,1]\n"
+    "\t--replay             Replay a recorded session instead of the cameras: two video files\n"
+    "\t                     (left,right), a directory with cam0/ and cam1/ image sequences,\n"
+    "\t                     or a .mkv/.mp4 container with one video track per camera\n"
+    "\t--pacing             Replay and synthetic pacing, fast or realtime [Default = fast]\n"
+    "\t--synthetic          Synthetic rig as key=value list: tx, ty, rot, scale, px, py (true\n"
+    "\t                     transform), noise, blur, gain, bias (degradations)\n"
+    "\t--truth              Write the true transform of the synthetic rig to this file\n"
+    "\t--drop               What to do with frames the processing has no time for: latest (keep\n"
+    "\t                     only the freshest), bounded (queue, drop oldest) or block [Default = latest]\n"
+    "\t--queue              Frames queued per camera for bounded and block [Default = 4]\n"
+    "\t--novelty            Feed a pair only if a camera's view changed by this much since the last\n"
+    "\t                     pair fed (mean grey level difference of thumbnails), 0 feeds all [Default = 2]\n"
+    "\t--record             Record every synchronised pair to this file, raw, for --replay\n"
+    "\t--latency            Also write the final per-stage latency report to this file\n"
+    "\t--converge           Estimate online (cpu backend) and stop feeding once an update moves the\n"
+    "\t                     transform by less than this many pixels three times in a row, 0 to\n"
+    "\t                     estimate only on c [Default = 0.5]\n"
+    "\t--auto-stop          Save and quit once the online estimate has converged\n"
+    "\t--refine             After each estimate (cpu backend), refine the transform by aligning the\n"
+    "\t                     intensities of the last pair fed, coarse to fine\n"
+    "\t--eval-level         Score PSNR/MSSIM (cpu backend) at 1/2 (1) or 1/4 (2) resolution, over\n"
+    "\t                     the overlap only [Default = 0, full resolution]\n"
+    "\t--index              Search of the correspondence history (cpu backend), key=value list of\n"
+    "\t                     LSH tables, bits and probes; more is better recall, slower\n"
+    "\t                     [Default = tables=6,bits=16,probes=1]\n"
+    "\t--headless           No windows and no per-frame rendering, for runs without a display\n"
+    "\t--control            Where headless runs read runtime commands from: - for stdin or the\n"
+    "\t                     path of a named pipe [Default = -]\n"
+    "\t--match-mode         Features of the cpu backends (and the mode handed to videostitcher):\n"
+    "\t                     0 ORB, 1 AKAZE, 2 BRISK (cpu backends only) [Default = 0]\n"
+    "\t--features           Most features per image, ORB, cpu backends [Default = 2000]\n"
+    "\t--levels             Detector pyramid levels (ORB) or octaves (AKAZE, BRISK), 0 for the\n"
+    "\t                     mode's default, cpu backends [Default = 0]\n"
+    "\t--threshold          Detector threshold: FAST (ORB), response (AKAZE) or AGAST (BRISK),\n"
+    "\t                     0 for the mode's default, cpu backends [Default = 0]\n"
+    "\t--bench-matchers     Time the descriptor matchers at 1k, 5k and 20k keypoints and quit\n"
+    "\t--bench-detectors    Run every match mode over the first 50 pairs of the source (replay or\n"
+    "\t                     synthetic, errors against the true transform) and quit\n"
     "\tc                    Runtime command to do a calibration\n"
     "\ts                    Runtime command to save current transform\n"
     "\tr                    Runtime command to reset (restart) calibration\n"
     "\tq                    Runtime command to stop capture and quit\n\n"
     "Example:\n"
-    "./camerascalib --width=1920 --height=1080 --fps=30 --out=/home/rose/cameras-1080p.xml\n\n"
+    "./camerascalib --width=1920 --height=1080 --fps=30 --out=/home/rose/cameras-1080p.xml\n"
+    "./camerascalib --replay=left.mp4,right.mp4 --pacing=realtime\n"
+    "./camerascalib --headless --control=/tmp/camerascalib.ctl, then echo c > /tmp/camerascalib.ctl\n"
+    "./camerascalib --record=field.rec, later ./camerascalib --replay=field.rec\n"
+    "./camerascalib --source=v4l2 --sensors=2,3 --width=1280 --height=720\n"
+    "./camerascalib --source=synthetic --synthetic=tx=-700,rot=2,noise=3,gain=1.3 --truth=truth.xml\n"
+    "./camerascalib --backend=cpu --headless --replay=field.rec\n"
+    "./camerascalib --source=v4l2 --sensors=0,1,2,3 --out=rig.xml\n"
+    "./camerascalib --source=synthetic --synthetic=tx=-500,noise=2 --bench-detectors\n\n"
     << std::endl;
 }
 
-static std::string create_capture (int camera, int width, int height, int fps)
+static void print_keyframes(const camerascalib::KeyframeGate& gate)
 {
-    std::stringstream pipeline_str;
-    pipeline_str << "nvarguscamerasrc sensor-id=" << std::to_string(camera) 
-        << " ! video/x-raw(memory:NVMM), width=(int)" << std::to_string(width) 
-        << ", height=(int)" << std::to_string(height)
-        << ", format=(string)NV12, framerate=(fraction)" << std::to_string(fps)
-        << "/1 ! nvvidconv ! video/x-raw, format=(string)BGRx ! videoconvert"
-        " ! video/x-raw, format=(string)BGR ! appsink ";
-
-    return pipeline_str.str();
+    std::cout << "Fed " << gate.Accepted() << " keyframes, skipped " << gate.Skipped() 
+        << " unchanged pairs." << std::endl;
+}
+
+static void print_drops(
+    const std::vector<std::shared_ptr<camerascalib::CaptureThread>>& captures,
+    const camerascalib::FrameSetPairer& pairer)
+{
+    std::cout << "Synchronised " << pairer.Paired() << " sets, dropped";
+    for (size_t i = 0; i < captures.size(); i++) {
+        std::cout << " camera " << i << ": " << captures[i]->DroppedInSource() 
+            << " in capture, " << captures[i]->DroppedInRing() << " stale,";
+    }
+    std::cout << " " << pairer.Unpaired() << " unpaired." << std::endl;
 }
 
 std::atomic<bool> g_stop;
@@ -62,29 +133,68 @@ int main(int argc, char const *argv[])
 {
     int return_val = 0;
     std::string calib_file; 
+    std::string backend;
     int width;
     int height;
     unsigned int fps;
+    std::vector<int> sensors;
+    bool luma = false;
+    int64_t start_time = 0;
+    int64_t stats_time = 0;
+    unsigned long frame_count = 0;
+    std::string latency_file;
 
-    std::string pipeline0, pipeline1;
-    cv::VideoCapture capture0, capture1;
-    videostitcher::CamerasCalib::Settings calib_settings; 
-    std::shared_ptr<videostitcher::CamerasCalib> calib; 
+    camerascalib::CaptureSettings capture_settings;
+    std::vector<std::shared_ptr<camerascalib::CaptureThread>> captures;
+    std::vector<camerascalib::FrameRing*> rings;
+    std::shared_ptr<camerascalib::FrameSetPairer> pairer;
+    std::string record_file;
+    camerascalib::RecordWriter recorder;
+    camerascalib::Calibrator::Settings calib_settings; 
+    std::shared_ptr<camerascalib::Calibrator> calib; 
 
-    std::vector<cv::Mat> images(2); 
-    std::vector<cv::cuda::GpuMat> cuda_images(2); 
-    cv::Mat matches_image; 
-    cv::cuda::GpuMat stitched_image; 
-    cv::Mat visual_stitching; 
-    double psnr = 0; 
-    cv::Scalar mssim; 
+    camerascalib::CalibPipeline::Settings pipeline_settings;
+    std::shared_ptr<camerascalib::CalibPipeline> pipeline;
+    bool headless = false;
+    bool auto_stop = false;
+    bool converged = false;
+    camerascalib::CommandChannel control;
+    camerascalib::DetectorBenchSettings bench_settings;
 
     const std::string keys =
     "{h help         |              | message }"
     "{width          |1920          | width }"
     "{height         |1080          | height }"
     "{fps            |30            | frame per second }"
-    "{out            |cameras.xml   | output path and file name }";
+    "{format         |bgrx          | capture pixel format }"
+    "{match-scale    |1             | matching branch scale }"
+    "{headless       |              | no display }"
+    "{control        |-             | command input when headless }"
+    "{luma           |              | luma only feature path }"
+    "{out            |cameras.xml   | output path and file name }"
+    "{backend        |              | calibrator backend }"
+    "{source         |gstreamer     | capture source }"
+    "{sensors        |0,1           | sensor ids }"
+    "{replay         |              | recorded session to replay }"
+    "{pacing         |fast          | replay pacing }"
+    "{drop           |latest        | frame drop policy }"
+    "{queue          |4             | frames queued per camera }"
+    "{novelty        |2             | keyframe threshold }"
+    "{converge       |0.5           | online convergence tolerance }"
+    "{auto-stop      |              | save and quit when converged }"
+    "{index          |              | history index settings }"
+    "{eval-level     |0             | evaluation pyramid level }"
+    "{refine         |              | photometric refinement }"
+    "{synthetic      |              | synthetic rig }"
+    "{truth          |              | true transform output }"
+    "{record         |              | recording output }"
+    "{latency        |              | latency report output }"
+    "{bench-matchers |              | matcher benchmark }"
+    "{bench-detectors|              | detector benchmark }"
+    "{match-mode     |0             | detector and descriptor }"
+    "{features       |2000          | max features }"
+    "{levels         |0             | detector pyramid levels }"
+    "{threshold      |0             | detector threshold }";
 
     cv::CommandLineParser cmd_parser(argc, argv, keys);
 
@@ -94,96 +204,308 @@ int main(int argc, char const *argv[])
         goto cleanup;
     }
 
+    if (cmd_parser.has("bench-matchers"))
+    {
+        return_val = camerascalib::BenchMatchers();
+        goto cleanup;
+    }
+
     calib_file = cmd_parser.get<std::string>("out"); 
+    backend = cmd_parser.get<std::string>("backend");
     width = cmd_parser.get<int>("width");
     height = cmd_parser.get<int>("height");
     fps = cmd_parser.get<unsigned int>("fps");
+    capture_settings.backend = cmd_parser.get<std::string>("source");
+    capture_settings.replay = cmd_parser.get<std::string>("replay");
+    capture_settings.synthetic = cmd_parser.get<std::string>("synthetic");
+    record_file = cmd_parser.get<std::string>("record");
+    latency_file = cmd_parser.get<std::string>("latency");
+    capture_settings.queue_size = (size_t)std::max(0, cmd_parser.get<int>("queue"));
+    capture_settings.match_scale = cmd_parser.get<double>("match-scale");
+    capture_settings.size = cv::Size(width, height);
+    capture_settings.fps = fps;
+    if (!capture_settings.replay.empty()) {
+        capture_settings.backend = "replay";
+    }
+    luma = cmd_parser.has("luma");
+    headless = cmd_parser.has("headless");
+    auto_stop = cmd_parser.has("auto-stop");
+    calib_settings.match_mode = cmd_parser.get<int>("match-mode");
+    calib_settings.detector.max_features = cmd_parser.get<int>("features");
+    calib_settings.detector.levels = cmd_parser.get<int>("levels");
+    calib_settings.detector.threshold = cmd_parser.get<double>("threshold");
+    calib_settings.tolerance = cmd_parser.get<double>("converge");
+    pipeline_settings.novelty = cmd_parser.get<double>("novelty");
+    calib_settings.eval_level = cmd_parser.get<int>("eval-level");
 
-    if (!cmd_parser.check())
+    if (!cmd_parser.check() ||
+        !camerascalib::ParsePacing(cmd_parser.get<std::string>("pacing"), capture_settings.pacing) ||
+        !camerascalib::ParsePixelFormat(cmd_parser.get<std::string>("format"), capture_settings.format) ||
+        !camerascalib::ParseDropPolicy(cmd_parser.get<std::string>("drop"), capture_settings.drop) ||
+        !camerascalib::ParseSensors(cmd_parser.get<std::string>("sensors"), sensors) ||
+        !camerascalib::ParseIndexSettings(cmd_parser.get<std::string>("index"), calib_settings.index) ||
+        sensors.size() < 2 ||
+        // frame periods and the pairing tolerance divide by it
+        fps < 1 ||
+        calib_settings.match_mode < 0 || calib_settings.match_mode >= camerascalib::match_modes ||
+        calib_settings.detector.max_features < 1 || calib_settings.detector.levels < 0 ||
+        calib_settings.detector.threshold < 0 ||
+        calib_settings.tolerance < 0 ||
+        // mean grey level difference
+        pipeline_settings.novelty < 0 || pipeline_settings.novelty > 255 ||
+        calib_settings.eval_level < 0 || calib_settings.eval_level > 2 ||
+        // appsink reads max-buffers=0 as unbounded
+        capture_settings.queue_size < 1)
     {
         cmd_parser.printErrors();
         help();
         return_val = -1;
         goto cleanup;
     }
+    if (luma && capture_settings.format != camerascalib::PIXEL_FORMAT_GRAY) {
+        capture_settings.format = camerascalib::PIXEL_FORMAT_NV12;
+    }
 
-    pipeline0 = create_capture(0, width, height, fps);
-    capture0.open(pipeline0, cv::CAP_GSTREAMER);
-    if (!capture0.isOpened())
+    capture_settings.cameras = (int)sensors.size();
+    for (int i = 0; i < capture_settings.cameras; i++)
     {
-        std::cerr << pipeline0 << std::endl; 
-        std::cerr << "Failed to open capture for first camera!" << std::endl;
-        return_val = -4;
-        goto cleanup;
+        captures.push_back(std::make_shared<camerascalib::CaptureThread>(i));
+        rings.push_back(&captures[i]->Ring());
+        std::shared_ptr<camerascalib::CaptureSource> source =
+            camerascalib::CreateCaptureSource(capture_settings, i, sensors[i]);
+        if (!source ||
+            !captures[i]->Open(source, capture_settings))
+        {
+            if (source) {
+                std::cerr << source->Description() << std::endl; 
+            }
+            std::cerr << "Failed to open " << capture_settings.backend 
+                << " capture for camera " << i << "!" << std::endl;
+            return_val = -4;
+            goto cleanup;
+        }
+        std::cout << "Camera " << i << ": " << source->Description() << " ("
+            << camerascalib::PixelFormatName(source->NativeFormat()) << ")" << std::endl;
     }
 
-    pipeline1 = create_capture(1, width, height, fps);
-    capture1.open(pipeline1, cv::CAP_GSTREAMER);
-    if (!capture1.isOpened())
+    if (capture_settings.backend == "synthetic")
     {
-        std::cerr << pipeline1 << std::endl; 
-        std::cerr << "Failed to open capture for second camera!" << std::endl;
+        camerascalib::SyntheticSettings synthetic;
+        camerascalib::ParseSyntheticSettings(capture_settings.synthetic, capture_settings.size,
+            synthetic);
+        cv::Mat truth(synthetic.Homography(1, capture_settings.size));
+        std::cout << "True transform:\n" << truth << std::endl;
+        bench_settings.has_truth = true;
+        bench_settings.truth = camerascalib::ScaleHomography(cv::Matx33d(truth),
+            capture_settings.size, capture_settings.MatchSize());
+
+        std::string truth_file = cmd_parser.get<std::string>("truth");
+        if (!truth_file.empty()) {
+            cv::FileStorage fs(truth_file, cv::FileStorage::WRITE);
+            fs << "transform" << truth;
+            if (capture_settings.cameras > 2) {
+                // laid out like a rig calibration
+                fs << "transforms" << "[";
+                for (int c = 0; c < capture_settings.cameras; c++) {
+                    fs << cv::Mat(synthetic.Homography(c, capture_settings.size));
+                }
+                fs << "]";
+            }
+        }
+    }
+
+    if (!record_file.empty() && !recorder.Open(record_file, capture_settings.cameras))
+    {
+        std::cerr << "Failed to open recording " << record_file << "!" << std::endl;
         return_val = -4;
         goto cleanup;
     }
 
     calib_settings.calib_file = calib_file; 
-    calib_settings.image_size = cv::Size(width, height);
-    calib_settings.match_mode = 0; 
-    calib.reset(new videostitcher::CamerasCalib(calib_settings));
+    calib_settings.cameras = capture_settings.cameras;
+    calib_settings.image_size = capture_settings.MatchSize();
+    calib_settings.full_size = capture_settings.size;
+    calib_settings.refine = cmd_parser.has("refine");
+
+    if (cmd_parser.has("bench-detectors"))
+    {
+        headless = true;
+        bench_settings.image_size = capture_settings.MatchSize();
+        bench_settings.luma = luma;
+        bench_settings.detector = calib_settings.detector;
+        pairer.reset(new camerascalib::FrameSetPairer(rings, 1000000000LL / fps / 2));
+        start_time = camerascalib::MonotonicNs();
+        for (const std::shared_ptr<camerascalib::CaptureThread>& capture : captures) {
+            capture->Start();
+        }
+        return_val = camerascalib::BenchDetectors(*pairer, bench_settings);
+        goto cleanup;
+    }
+    if (!backend.empty()) {
+        calib_settings.backend = backend;
+    }
+    else if (calib_settings.cameras > 2) {
+        calib_settings.backend = "cpu";
+    }
+    if (calib_settings.backend == "cuda")
+    {
+        // videostitcher knows ORB and AKAZE only and takes no detector parameters
+        camerascalib::DetectorSettings defaults;
+        if (calib_settings.match_mode > 1 ||
+            calib_settings.detector.max_features != defaults.max_features ||
+            calib_settings.detector.levels != defaults.levels ||
+            calib_settings.detector.threshold != defaults.threshold)
+        {
+            std::cerr << "The cuda backend takes --match-mode 0 or 1 and no --features, --levels "
+                "or --threshold!" << std::endl;
+            return_val = -1;
+            goto cleanup;
+        }
+        // videostitcher saves at the size it calibrates at, which would be the branch's
+        if (calib_settings.image_size != calib_settings.full_size)
+        {
+            std::cerr << "The cuda backend calibrates at capture size, no --match-scale below 1!"
+                << std::endl;
+            return_val = -1;
+            goto cleanup;
+        }
+    }
+    calib = camerascalib::CreateCalibrator(calib_settings);
     if (!calib) {
-        std::cerr << "Failed to start calibrator!" << std::endl;
+        std::cerr << "Failed to start calibrator " << calib_settings.backend << "!" << std::endl;
         return_val = -5;
         goto cleanup;
     }
+    std::cout << "Calibrator: " << calib_settings.backend << std::endl;
 
-    cv::namedWindow(matches_window, cv::WINDOW_NORMAL); 
-    cv::namedWindow(warping_window, cv::WINDOW_NORMAL); 
+    if (headless)
+    {
+        if (!control.Open(cmd_parser.get<std::string>("control")))
+        {
+            std::cerr << "Failed to open control channel!" << std::endl;
+            return_val = -1;
+            goto cleanup;
+        }
+    }
+    else
+    {
+        cv::namedWindow(matches_window, cv::WINDOW_NORMAL); 
+        cv::namedWindow(warping_window, cv::WINDOW_NORMAL); 
 
-    cv::resizeWindow(matches_window, window_width, window_height);
-    cv::resizeWindow(warping_window, window_width, window_height);
+        cv::resizeWindow(matches_window, window_width, window_height);
+        cv::resizeWindow(warping_window, window_width, window_height);
 
-    cv::moveWindow(matches_window, 200, 100); 
-    cv::moveWindow(warping_window, window_width + 250, 100); 
+        cv::moveWindow(matches_window, 200, 100); 
+        cv::moveWindow(warping_window, window_width + 250, 100); 
+    }
+
+    // pair frames taken within half a frame period of each other
+    pairer.reset(new camerascalib::FrameSetPairer(rings, 1000000000LL / fps / 2));
+    start_time = camerascalib::MonotonicNs();
+    stats_time = start_time;
+    for (const std::shared_ptr<camerascalib::CaptureThread>& capture : captures) {
+        capture->Start();
+    }
+
+    pipeline_settings.luma = luma;
+    pipeline_settings.render = !headless;
+    pipeline.reset(new camerascalib::CalibPipeline(pipeline_settings, *pairer, calib,
+        record_file.empty() ? nullptr : &recorder));
+    pipeline->Start();
 
-    unsigned long frame_count; 
     g_stop = false;
     signal(SIGINT, signal_callback_handler);
     while (!g_stop)
     {
-        // std::cout << "frame " << frame_count++ << std::endl; 
-        capture0 >> images[0];
-        capture1 >> images[1]; 
-
-        cuda_images[0].upload(images[0]); 
-        cuda_images[1].upload(images[1]);
+        int key = -1;
+        camerascalib::PairWork* work = pipeline->Next(100);
+        if (work) {
+            frame_count++;
+            if (camerascalib::MonotonicNs() - stats_time > stats_interval * 1000000000LL) {
+                print_drops(captures, *pairer);
+                print_keyframes(pipeline->Gate());
+                std::cout << "PSNR " << work->psnr << ", MSSIM " << work->mssim[0];
+                if (work->convergence >= 0) {
+                    std::cout << ", last update moved the transform " << work->convergence << " px";
+                }
+                std::cout << std::endl;
+                pipeline->Timers().PrintSummary(std::cout);
+                stats_time = camerascalib::MonotonicNs();
+            }
+            if (work->converged != converged) {
+                converged = work->converged;
+                if (converged) {
+                    std::cout << "Transform converged (" << work->convergence 
+                        << " px per update), no longer feeding." << std::endl;
+                    if (auto_stop) {
+                        pipeline->Command('s');
+                        g_stop = true;
+                    }
+                }
+            }
+            if (!headless) {
+                camerascalib::ScopedLatency timer(&pipeline->Timers(), camerascalib::STAGE_IMSHOW);
+                cv::imshow(matches_window, work->matches_image);
+                cv::imshow(warping_window, work->visual_stitching);
+            }
+            pipeline->Release(work);
+        }
+        else if (pipeline->Finished()) {
+            break;
+        }
 
-        calib->Feed(cuda_images); 
-        calib->Matches(images, matches_image); 
-        calib->Evaluate(cuda_images, psnr, mssim, stitched_image); 
-        stitched_image.download(visual_stitching); 
-        cv::imshow(matches_window, matches_image);
-        cv::imshow(warping_window, visual_stitching);
-        int key = cv::waitKey(1);
+        if (headless) {
+            control.Poll(key);
+        }
+        else {
+            // every pass, so the windows repaint and keys are read while capture stalls
+            camerascalib::ScopedLatency timer(&pipeline->Timers(), camerascalib::STAGE_WAITKEY);
+            key = cv::waitKey(1);
+        }
 
         // 'q' for termination
         if (key == 'q' ) {
             break;
         }
-        else if (key == 'c') {
-            calib->Estimate();  
-        }
-        else if (key == 's') {
-            calib->Save(); 
-        }
-        else if (key == 'r') {
-            calib->Reset(); 
+        else if (key == 'c' || key == 's' || key == 'r') {
+            // run on the calibrate stage, between two pairs
+            pipeline->Command(key); 
         }
     }
 
 cleanup:
-    capture0.release();
-    capture1.release();
-    cv::destroyAllWindows(); 
+    if (pipeline) {
+        pipeline->Stop();
+        print_keyframes(pipeline->Gate());
+        std::cout << "Displayed " << frame_count << " pairs." << std::endl;
+        pipeline->Timers().PrintReport(std::cout);
+        if (!latency_file.empty()) {
+            std::ofstream report(latency_file);
+            pipeline->Timers().PrintReport(report);
+            if (!report) {
+                std::cerr << "Failed to write latency report " << latency_file << "!" << std::endl;
+            }
+        }
+    }
+    control.Close();
+    for (const std::shared_ptr<camerascalib::CaptureThread>& capture : captures) {
+        capture->Stop();
+    }
+    if (!record_file.empty()) {
+        recorder.Close();
+        std::cout << "Recorded " << recorder.Written() << " pairs to " << record_file 
+            << ", dropped " << recorder.Dropped() << "." << std::endl;
+    }
+    if (pairer) {
+        print_drops(captures, *pairer);
+        double seconds = (camerascalib::MonotonicNs() - start_time) / 1e9;
+        if (seconds > 0) {
+            std::cout << "Processed " << pairer->Paired() / seconds 
+                << " sets per second over " << seconds << " s." << std::endl;
+        }
+    }
+    if (!headless) {
+        cv::destroyAllWindows(); 
+    }
     return return_val;
 }
@@ -0,0 +1,140 @@
+#include "capture_source.h"
+
+#include <sstream>
+#include <cstdlib>
+#include <thread>
+
+#include "camera_source.h"
+#include "replay_source.h"
+#include "synthetic_source.h"
+
+namespace camerascalib {
+
+cv::Size CaptureSettings::MatchSize() const
+{
+    if (match_scale >= 1.0 || match_scale <= 0) {
+        return size;
+    }
+    return cv::Size((int)(size.width * match_scale) & ~1, (int)(size.height * match_scale) & ~1);
+}
+
+std::shared_ptr<CaptureSource> CreateCaptureSource(const CaptureSettings& settings,
+    int camera, int sensor)
+{
+    std::shared_ptr<CaptureSource> source;
+    if (settings.backend == "gstreamer") {
+        source.reset(new GStreamerSource(sensor, settings));
+    }
+    else if (settings.backend == "v4l2") {
+        source.reset(new V4l2Source(sensor, settings));
+    }
+    else if (settings.backend == "replay") {
+        source.reset(new ReplaySource(camera, settings));
+    }
+    else if (settings.backend == "synthetic") {
+        source.reset(new SyntheticSource(camera, settings));
+    }
+    return source;
+}
+
+void PaceFrame(int64_t& start, int64_t timestamp)
+{
+    if (start == 0) {
+        start = MonotonicNs();
+    }
+    int64_t wait = start + timestamp - MonotonicNs();
+    if (wait > 0) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+    }
+}
+
+bool ParsePacing(const std::string& name, Pacing& pacing)
+{
+    if (name == "fast") {
+        pacing = PACING_FAST;
+    }
+    else if (name == "realtime") {
+        pacing = PACING_REALTIME;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+bool ParseDropPolicy(const std::string& name, DropPolicy& policy)
+{
+    if (name == "latest") {
+        policy = DROP_LATEST;
+    }
+    else if (name == "bounded") {
+        policy = DROP_BOUNDED;
+    }
+    else if (name == "block") {
+        policy = DROP_BLOCK;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+bool ParseSensors(const std::string& list, std::vector<int>& sensors)
+{
+    sensors.clear();
+    for (const std::string& item : SplitList(list)) {
+        char* end = nullptr;
+        long id = std::strtol(item.c_str(), &end, 10);
+        if (item.empty() || *end != '\0' || id < 0) {
+            return false;
+        }
+        sensors.push_back((int)id);
+    }
+    return !sensors.empty();
+}
+
+std::vector<std::string> SplitList(const std::string& list, char delimiter)
+{
+    std::vector<std::string> items;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, delimiter)) {
+        items.push_back(item);
+    }
+    return items;
+}
+
+template <typename T>
+bool ParseKeyValues(const std::string& list, const std::vector<KeyValue<T>>& fields)
+{
+    for (const std::string& item : SplitList(list))
+    {
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) {
+            return false;
+        }
+        std::string key = item.substr(0, eq);
+        char* end = nullptr;
+        double value = std::strtod(item.c_str() + eq + 1, &end);
+        if (end == item.c_str() + eq + 1 || *end != '\0' || (T)value != value) {
+            return false;
+        }
+
+        bool known = false;
+        for (const KeyValue<T>& field : fields) {
+            if (key == field.key) {
+                *field.value = (T)value;
+                known = true;
+            }
+        }
+        if (!known) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template bool ParseKeyValues<int>(const std::string&, const std::vector<KeyValue<int>>&);
+template bool ParseKeyValues<double>(const std::string&, const std::vector<KeyValue<double>>&);
+
+} // namespace camerascalib
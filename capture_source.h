@@ -0,0 +1,100 @@
+#ifndef CAMERASCALIB_CAPTURE_SOURCE_H
+#define CAMERASCALIB_CAPTURE_SOURCE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "frame.h"
+
+namespace camerascalib {
+
+// How a non-live source delivers its frames
+enum Pacing
+{
+    PACING_FAST,        // as fast as the consumer takes them, never drop
+    PACING_REALTIME     // at the nominal frame rate, dropping like a live camera
+};
+
+// What happens to frames the processing stages do not take in time
+enum DropPolicy
+{
+    DROP_LATEST,        // keep only the freshest frame (appsink max-buffers=1 drop=true)
+    DROP_BOUNDED,       // keep a bounded queue, dropping the oldest frames
+    DROP_BLOCK          // keep a bounded queue and hold the capture back when it is full
+};
+
+struct CaptureSettings
+{
+    std::string backend = "gstreamer";  // gstreamer, v4l2, replay or synthetic
+    cv::Size size = cv::Size(1920, 1080);
+    unsigned int fps = 30;
+    PixelFormat format = PIXEL_FORMAT_BGRX;  // requested from the capture, where it has a choice
+    std::string replay;                 // recorded session for the replay backend
+    std::string synthetic;              // scene and transform of the synthetic backend
+    Pacing pacing = PACING_FAST;
+    int cameras = 2;                    // number of cameras in the rig
+    DropPolicy drop = DROP_LATEST;      // for live sources
+    size_t queue_size = 4;              // frames buffered per camera, unless DROP_LATEST
+    double match_scale = 1.0;           // size of the matching branch relative to the capture
+
+    // Size of the matching branch, even so NV12 can be scaled; equal to size
+    // when there is no separate branch
+    cv::Size MatchSize() const;
+};
+
+// One camera of the rig. Read() blocks until the next frame is available and
+// fills in its timestamp, sequence number and pixel format.
+class CaptureSource
+{
+public:
+    virtual ~CaptureSource() {}
+
+    virtual bool Open() = 0;
+    virtual bool Read(Frame& frame) = 0;
+    virtual void Close() {}
+
+    // Format of the frames as produced, before any conversion
+    virtual PixelFormat NativeFormat() const = 0;
+
+    // A live source overwrites frames the consumer did not take in time,
+    // a non-live one waits for the consumer instead.
+    virtual bool Live() const = 0;
+
+    virtual std::string Description() const = 0;
+
+    // Frames lost before they reached Read(), as far as the source can tell
+    virtual unsigned long Dropped() const { return 0; }
+};
+
+// Create the source for one camera of the rig: camera is its position in
+// the rig, sensor the id (or device number) of the hardware behind it.
+std::shared_ptr<CaptureSource> CreateCaptureSource(const CaptureSettings& settings,
+    int camera, int sensor);
+
+// Sleep until a frame stamped timestamp (relative to the first frame) is due
+// when played back in real time. start is set on the first call.
+void PaceFrame(int64_t& start, int64_t timestamp);
+
+bool ParsePacing(const std::string& name, Pacing& pacing);
+bool ParseDropPolicy(const std::string& name, DropPolicy& policy);
+bool ParseSensors(const std::string& list, std::vector<int>& sensors);
+std::vector<std::string> SplitList(const std::string& list, char delimiter = ',');
+
+// A field a key=value list may set
+template <typename T>
+struct KeyValue
+{
+    const char* key;
+    T* value;
+};
+
+// Parse a comma separated key=value list into fields, leaving those not
+// named as they are. False on an item without '=', an unknown key or a
+// value that is not a number (an integer, for int fields).
+template <typename T>
+bool ParseKeyValues(const std::string& list, const std::vector<KeyValue<T>>& fields);
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_CAPTURE_SOURCE_H
@@ -0,0 +1,140 @@
+#include "capture_thread.h"
+
+#include <iostream>
+#include <cstdlib>
+
+namespace camerascalib {
+
+CaptureThread::CaptureThread(int camera)
+    : camera_(camera)
+    , ring_(1)
+    , block_(false)
+    , running_(false)
+    , captured_(0)
+{
+}
+
+CaptureThread::~CaptureThread()
+{
+    Stop();
+    if (source_) {
+        source_->Close();
+    }
+}
+
+bool CaptureThread::Open(const std::shared_ptr<CaptureSource>& source,
+    const CaptureSettings& settings)
+{
+    source_ = source;
+    if (!source_ || !source_->Open()) {
+        return false;
+    }
+    block_ = !source_->Live() || settings.drop == DROP_BLOCK;
+    ring_.Reset(settings.drop == DROP_LATEST && source_->Live() ? 1 : settings.queue_size);
+    if (settings.MatchSize() != settings.size) {
+        match_size_ = settings.MatchSize();
+    }
+    return true;
+}
+
+void CaptureThread::Start()
+{
+    running_ = true;
+    thread_ = std::thread(&CaptureThread::Run, this);
+}
+
+void CaptureThread::Stop()
+{
+    running_ = false;
+    ring_.Close();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void CaptureThread::Run()
+{
+    while (running_)
+    {
+        Frame frame;
+        if (!source_->Read(frame)) {
+            std::cerr << "Capture of camera " << camera_ << " ended." << std::endl;
+            break;
+        }
+        if (frame.image.empty()) {
+            continue;
+        }
+        frame.arrival = MonotonicNs();
+        if (!match_size_.empty()) {
+            ScaleFrame(frame, match_size_, frame.scaled);
+        }
+        ++captured_;
+
+        if (!ring_.Push(std::move(frame), block_)) {
+            break;
+        }
+    }
+    ring_.Close();
+}
+
+FrameSetPairer::FrameSetPairer(FrameRing& ring0, FrameRing& ring1, int64_t tolerance_ns)
+    : FrameSetPairer(std::vector<FrameRing*>{ &ring0, &ring1 }, tolerance_ns)
+{
+}
+
+FrameSetPairer::FrameSetPairer(const std::vector<FrameRing*>& rings, int64_t tolerance_ns)
+    : rings_(rings)
+    , tolerance_ns_(tolerance_ns)
+    , paired_(0)
+    , unpaired_(0)
+    , last_skew_(0)
+{
+}
+
+bool FrameSetPairer::Next(std::vector<Frame>& frames, int timeout_ms)
+{
+    frames.resize(rings_.size());
+    for (;;)
+    {
+        size_t oldest = 0;
+        size_t newest = 0;
+        for (size_t i = 0; i < rings_.size(); i++)
+        {
+            if (!rings_[i]->WaitFront(frames[i], timeout_ms)) {
+                return false;
+            }
+            if (frames[i].timestamp < frames[oldest].timestamp) {
+                oldest = i;
+            }
+            if (frames[i].timestamp > frames[newest].timestamp) {
+                newest = i;
+            }
+        }
+
+        int64_t skew = frames[newest].timestamp - frames[oldest].timestamp;
+        if (skew <= tolerance_ns_) {
+            for (size_t i = 0; i < rings_.size(); i++) {
+                rings_[i]->PopFront(frames[i].sequence);
+            }
+            last_skew_ = skew;
+            ++paired_;
+            return true;
+        }
+
+        // the oldest frame can no longer find partners
+        rings_[oldest]->PopFront(frames[oldest].sequence);
+        ++unpaired_;
+    }
+}
+
+bool FrameSetPairer::Finished() const
+{
+    for (FrameRing* ring : rings_) {
+        if (ring->Closed() && ring->Size() == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace camerascalib
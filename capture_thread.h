@@ -0,0 +1,85 @@
+#ifndef CAMERASCALIB_CAPTURE_THREAD_H
+#define CAMERASCALIB_CAPTURE_THREAD_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <memory>
+
+#include "frame_ring.h"
+#include "capture_source.h"
+
+namespace camerascalib {
+
+// Reads one capture source on its own thread, so the cameras of the rig are
+// never serialised behind each other. When a matching branch is requested
+// the frame is also downscaled here, off the processing thread: OpenCV
+// exposes a single appsink per capture, so this stands in for a tee in the
+// pipeline.
+class CaptureThread
+{
+public:
+    explicit CaptureThread(int camera);
+    ~CaptureThread();
+
+    // Open the source and size the ring for the drop policy. Sources that
+    // are not live always block, they must not lose frames.
+    bool Open(const std::shared_ptr<CaptureSource>& source, const CaptureSettings& settings);
+    void Start();
+    void Stop();
+
+    int Camera() const { return camera_; }
+    const std::shared_ptr<CaptureSource>& Source() const { return source_; }
+    FrameRing& Ring() { return ring_; }
+    unsigned long Captured() const { return captured_; }
+
+    // Frames lost before the ring (in the source) and in the ring (overwritten)
+    unsigned long DroppedInSource() const { return source_ ? source_->Dropped() : 0; }
+    unsigned long DroppedInRing() const { return ring_.Overwritten(); }
+
+private:
+    void Run();
+
+    int camera_;
+    std::shared_ptr<CaptureSource> source_;
+    FrameRing ring_;
+    bool block_;
+    cv::Size match_size_;
+    std::thread thread_;
+    std::atomic<bool> running_;
+    std::atomic<unsigned long> captured_;
+};
+
+// Matches the frames of two or more capture rings by timestamp. A frame that
+// has no partner in every other ring within the tolerance is dropped, so only
+// synchronised sets, one frame per camera (a pair for a stereo rig), reach
+// the calibrator.
+class FrameSetPairer
+{
+public:
+    FrameSetPairer(FrameRing& ring0, FrameRing& ring1, int64_t tolerance_ns);
+    FrameSetPairer(const std::vector<FrameRing*>& rings, int64_t tolerance_ns);
+
+    // Wait up to timeout_ms for the next synchronised set, one frame per ring.
+    bool Next(std::vector<Frame>& frames, int timeout_ms);
+
+    // True once a ring has been closed and drained.
+    bool Finished() const;
+
+    unsigned long Paired() const { return paired_; }
+    unsigned long Unpaired() const { return unpaired_; }
+    // Spread of the timestamps of the last set
+    int64_t LastSkew() const { return last_skew_; }
+
+private:
+    std::vector<FrameRing*> rings_;
+    int64_t tolerance_ns_;
+    std::atomic<unsigned long> paired_;
+    std::atomic<unsigned long> unpaired_;
+    std::atomic<int64_t> last_skew_;
+};
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_CAPTURE_THREAD_H
@@ -0,0 +1,91 @@
+#include "command_channel.h"
+
+#include <cctype>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace camerascalib {
+
+CommandChannel::CommandChannel()
+    : fd_(-1)
+    , owns_fd_(false)
+    , commands_(16)
+    , stop_(false)
+{
+}
+
+CommandChannel::~CommandChannel()
+{
+    Close();
+}
+
+bool CommandChannel::Open(const std::string& path)
+{
+    if (path == "-") {
+        fd_ = STDIN_FILENO;
+        owns_fd_ = false;
+    }
+    else {
+        if (::mkfifo(path.c_str(), 0660) != 0 && errno != EEXIST) {
+            return false;
+        }
+        // read-write so the pipe never reports end of file between writers
+        fd_ = ::open(path.c_str(), O_RDWR | O_NONBLOCK);
+        if (fd_ < 0) {
+            return false;
+        }
+        owns_fd_ = true;
+    }
+
+    stop_ = false;
+    thread_ = std::thread(&CommandChannel::Run, this);
+    return true;
+}
+
+void CommandChannel::Close()
+{
+    stop_ = true;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    if (owns_fd_ && fd_ >= 0) {
+        ::close(fd_);
+    }
+    fd_ = -1;
+    owns_fd_ = false;
+}
+
+bool CommandChannel::Poll(int& key)
+{
+    return commands_.TryPop(key);
+}
+
+void CommandChannel::Run()
+{
+    char buffer[64];
+    while (!stop_)
+    {
+        struct pollfd pfd = { fd_, POLLIN, 0 };
+        int ready = ::poll(&pfd, 1, 100);
+        if (ready <= 0 || !(pfd.revents & (POLLIN | POLLHUP))) {
+            continue;
+        }
+
+        ssize_t count = ::read(fd_, buffer, sizeof(buffer));
+        if (count == 0) {
+            // stdin closed, nothing more will come
+            break;
+        }
+        for (ssize_t i = 0; i < count; i++) {
+            if (!std::isspace((unsigned char)buffer[i])) {
+                commands_.Push(buffer[i], stop_);
+            }
+        }
+    }
+}
+
+} // namespace camerascalib
@@ -0,0 +1,39 @@
+#ifndef CAMERASCALIB_COMMAND_CHANNEL_H
+#define CAMERASCALIB_COMMAND_CHANNEL_H
+
+#include <string>
+#include <thread>
+#include <atomic>
+
+#include "spsc_queue.h"
+
+namespace camerascalib {
+
+// Runtime commands (c, s, r, q) for headless runs, read on a thread of its
+// own from stdin or from a named pipe, e.g. `echo c > /tmp/camerascalib.ctl`.
+class CommandChannel
+{
+public:
+    CommandChannel();
+    ~CommandChannel();
+
+    // "-" reads stdin, anything else is a named pipe, created if missing
+    bool Open(const std::string& path);
+    void Close();
+
+    // Next command received, if any
+    bool Poll(int& key);
+
+private:
+    void Run();
+
+    int fd_;
+    bool owns_fd_;
+    SpscQueue<int> commands_;
+    std::atomic<bool> stop_;
+    std::thread thread_;
+};
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_COMMAND_CHANNEL_H
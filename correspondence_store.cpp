@@ -0,0 +1,105 @@
+#include "correspondence_store.h"
+
+#include <algorithm>
+
+namespace camerascalib {
+
+static const int tournament = 4;    // members drawn to pick one to evict
+
+CorrespondenceStore::CorrespondenceStore(const Settings& settings, cv::Size size)
+    : settings_(settings)
+    , size_(size)
+{
+    settings_.columns = std::max(1, settings_.columns);
+    settings_.rows = std::max(1, settings_.rows);
+    settings_.capacity = std::max<size_t>(1, settings_.capacity);
+    Clear();
+}
+
+void CorrespondenceStore::Clear()
+{
+    points_.Clear();
+    quality_.clear();
+    slots_.assign(settings_.columns * settings_.rows, std::vector<int>());
+    offered_.assign(settings_.columns * settings_.rows, 0);
+    occupied_ = 0;
+    replaced_ = 0;
+    // the same choices every run, so sessions replay the same
+    rng_ = cv::RNG(0xb0c);
+}
+
+int CorrespondenceStore::Bucket(const cv::Point2f& p) const
+{
+    int column = (int)(p.x * settings_.columns / std::max(1, size_.width));
+    int row = (int)(p.y * settings_.rows / std::max(1, size_.height));
+    column = std::min(std::max(column, 0), settings_.columns - 1);
+    row = std::min(std::max(row, 0), settings_.rows - 1);
+    return row * settings_.columns + column;
+}
+
+size_t CorrespondenceStore::Victim(int bucket)
+{
+    const std::vector<int>& slots = slots_[bucket];
+    size_t victim = rng_.uniform(0, (int)slots.size());
+    for (int i = 1; i < tournament; i++) {
+        size_t other = rng_.uniform(0, (int)slots.size());
+        if (quality_[slots[other]] < quality_[slots[victim]]) {
+            victim = other;
+        }
+    }
+    return victim;
+}
+
+int CorrespondenceStore::Offer(const cv::Point2f& p0, const cv::Point2f& p1, float quality)
+{
+    int bucket = Bucket(p0);
+    std::vector<int>& slots = slots_[bucket];
+    uint64_t offered = ++offered_[bucket];
+    if (slots.empty()) {
+        occupied_++;
+    }
+    if (points_.Size() < settings_.capacity)
+    {
+        int slot = (int)points_.Size();
+        points_.Push(p0, p1);
+        quality_.push_back(quality);
+        slots.push_back(slot);
+        return slot;
+    }
+
+    size_t share = std::max<size_t>(1, settings_.capacity / occupied_);
+    int slot;
+    if (slots.size() < share)
+    {
+        // short of its share: the fullest bucket gives up a member
+        int fullest = 0;
+        for (int b = 1; b < (int)slots_.size(); b++) {
+            if (slots_[b].size() > slots_[fullest].size()) {
+                fullest = b;
+            }
+        }
+        std::vector<int>& donor = slots_[fullest];
+        size_t victim = Victim(fullest);
+        slot = donor[victim];
+        donor[victim] = donor.back();
+        donor.pop_back();
+        if (donor.empty()) {
+            occupied_--;
+        }
+        slots.push_back(slot);
+    }
+    else
+    {
+        // reservoir sampling: each offered equally likely to be kept
+        if ((uint64_t)rng_.uniform(0.0, (double)offered) >= slots.size()) {
+            return -1;
+        }
+        slot = slots[Victim(bucket)];
+    }
+    points_.Set(slot, p0, p1);
+    quality_[slot] = quality;
+    replaced_++;
+    return slot;
+}
+
+} // namespace camerascalib
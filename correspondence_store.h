@@ -0,0 +1,67 @@
+#ifndef CAMERASCALIB_CORRESPONDENCE_STORE_H
+#define CAMERASCALIB_CORRESPONDENCE_STORE_H
+
+#include <vector>
+#include <cstdint>
+
+#include <opencv2/core/core.hpp>
+
+#include "correspondences.h"
+
+namespace camerascalib {
+
+// Correspondences kept within a fixed capacity, spread evenly over where
+// camera 0 sees them. The image is divided into a grid of buckets; until the
+// store is full every correspondence is taken. After that the capacity is
+// shared equally by the buckets that have received any, so a rig whose
+// overlap covers only a few columns still keeps the full capacity there.
+// A bucket below its share takes a new correspondence from the fullest
+// bucket; one at its share takes each with probability size/offered
+// (reservoir sampling) in place of one of its own members. The member that
+// goes is the worst of a few drawn at random, so weak matches go first but
+// early strong ones can go too and all of a session stays represented.
+// Everything lives in one flat structure of arrays, indexed by slot, that
+// estimators read directly.
+class CorrespondenceStore
+{
+public:
+    struct Settings
+    {
+        int columns = 8;
+        int rows = 6;
+        size_t capacity = 20000;
+    };
+
+    CorrespondenceStore(const Settings& settings, cv::Size size);
+
+    // Offer a correspondence of the given quality (higher is better). The
+    // slot it was stored in, a new one (Size() - 1) or one it replaced, or
+    // -1 if it was passed over.
+    int Offer(const cv::Point2f& p0, const cv::Point2f& p1, float quality);
+
+    const Correspondences& Points() const { return points_; }
+    size_t Size() const { return points_.Size(); }
+    // Correspondences replaced so far, for callers keeping data by slot
+    uint64_t Replaced() const { return replaced_; }
+
+    void Clear();
+
+private:
+    int Bucket(const cv::Point2f& p) const;
+    // Position in slots_[bucket] of the member to evict
+    size_t Victim(int bucket);
+
+    Settings settings_;
+    cv::Size size_;
+    int occupied_;                          // buckets that have received any
+    Correspondences points_;
+    std::vector<float> quality_;            // per slot
+    std::vector<std::vector<int>> slots_;   // per bucket
+    std::vector<uint64_t> offered_;         // per bucket
+    uint64_t replaced_;
+    cv::RNG rng_;
+};
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_CORRESPONDENCE_STORE_H
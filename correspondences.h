@@ -0,0 +1,53 @@
+#ifndef CAMERASCALIB_CORRESPONDENCES_H
+#define CAMERASCALIB_CORRESPONDENCES_H
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace camerascalib {
+
+// Point correspondences between two cameras, kept as a structure of arrays
+// so that scoring a transform over all of them streams four contiguous
+// float arrays through SIMD registers
+struct Correspondences
+{
+    std::vector<float> x0;
+    std::vector<float> y0;
+    std::vector<float> x1;
+    std::vector<float> y1;
+
+    size_t Size() const { return x0.size(); }
+    bool Empty() const { return x0.empty(); }
+
+    void Push(const cv::Point2f& p0, const cv::Point2f& p1)
+    {
+        x0.push_back(p0.x);
+        y0.push_back(p0.y);
+        x1.push_back(p1.x);
+        y1.push_back(p1.y);
+    }
+
+    void Set(size_t i, const cv::Point2f& p0, const cv::Point2f& p1)
+    {
+        x0[i] = p0.x;
+        y0[i] = p0.y;
+        x1[i] = p1.x;
+        y1[i] = p1.y;
+    }
+
+    void Clear()
+    {
+        x0.clear();
+        y0.clear();
+        x1.clear();
+        y1.clear();
+    }
+
+    cv::Point2f Point0(size_t i) const { return cv::Point2f(x0[i], y0[i]); }
+    cv::Point2f Point1(size_t i) const { return cv::Point2f(x1[i], y1[i]); }
+};
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_CORRESPONDENCES_H
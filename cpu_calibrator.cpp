@@ -0,0 +1,253 @@
+#include "cpu_calibrator.h"
+
+#include <cmath>
+#include <iostream>
+
+#include <opencv2/core/utility.hpp>
+
+#include "matching.h"
+#include "evaluation.h"
+#include "ransac.h"
+#include "lucas_kanade.h"
+
+namespace camerascalib {
+
+static const float repeat_radius = 1.5f;   // pixels, in both cameras, for a repeated correspondence
+
+static OnlineEstimator::Settings online_settings(const Calibrator::Settings& settings)
+{
+    OnlineEstimator::Settings online_settings;
+    online_settings.tolerance = settings.tolerance;
+    return online_settings;
+}
+
+static CorrespondenceStore::Settings store_settings(const Calibrator::Settings& settings)
+{
+    CorrespondenceStore::Settings store_settings;
+    store_settings.capacity = settings.max_correspondences;
+    return store_settings;
+}
+
+CpuCalibrator::CpuCalibrator(const Settings& settings)
+    : settings_(settings)
+    , store_(store_settings(settings), settings.image_size)
+    , indexed_replaced_(0)
+    , online_(online_settings(settings), settings.image_size)
+    , evaluator_(settings.eval_level)
+    , transform_(cv::Matx33d::eye())
+    , estimated_(false)
+{
+    if (settings_.full_size.area() == 0) {
+        settings_.full_size = settings_.image_size;
+    }
+    for (int i = 0; i < 2; i++) {
+        detectors_[i] = CreateDetector(settings_.match_mode, settings_.detector);
+    }
+    matcher_ = cv::BFMatcher::create(detectors_[0]->defaultNorm());
+    history_ = CreateDescriptorIndex(detectors_[0]->descriptorType(), settings_.index);
+    // carry on from a previous calibration, if there is one
+    Load();
+}
+
+const PairFeatures& CpuCalibrator::Features(const std::vector<cv::Mat>& images,
+    uint64_t sequence)
+{
+    const PairFeatures* cached = cache_.Find(sequence);
+    if (cached) {
+        return *cached;
+    }
+    PairFeatures& features = cache_.Insert(sequence);
+    Detect(images, features);
+    Match(features);
+    return features;
+}
+
+void CpuCalibrator::Detect(const std::vector<cv::Mat>& images, PairFeatures& features)
+{
+    cv::parallel_for_(cv::Range(0, 2), [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; i++) {
+            cv::Mat gray;
+            ToGray(images[i], gray);
+            detectors_[i]->detectAndCompute(gray, cv::noArray(),
+                features.keypoints[i], features.descriptors[i]);
+        }
+    });
+}
+
+void CpuCalibrator::Match(PairFeatures& features)
+{
+    RatioMatch(*matcher_, features.descriptors[0], features.descriptors[1], features.matches[0]);
+}
+
+void CpuCalibrator::Feed(cv::InputArrayOfArrays images, uint64_t sequence)
+{
+    std::vector<cv::Mat> pair;
+    images.getMatVector(pair);
+
+    const PairFeatures& features = Features(pair, sequence);
+    const std::vector<cv::DMatch>& matches = features.matches[0];
+    cv::Mat descriptors;
+    for (const cv::DMatch& match : matches) {
+        descriptors.push_back(features.descriptors[0].row(match.queryIdx));
+    }
+    std::vector<int> seen;
+    std::vector<float> distances;
+    if (history_) {
+        history_->Search(descriptors, seen, distances);
+    }
+
+    const Correspondences& points = store_.Points();
+    Correspondences added;
+    cv::Mat appended;
+    for (size_t k = 0; k < matches.size(); k++)
+    {
+        const cv::Point2f& p0 = features.keypoints[0][matches[k].queryIdx].pt;
+        const cv::Point2f& p1 = features.keypoints[1][matches[k].trainIdx].pt;
+        if (!seen.empty() && seen[k] >= 0 && (size_t)seen[k] < points.Size() &&
+            cv::norm(points.Point0(seen[k]) - p0) <= repeat_radius &&
+            cv::norm(points.Point1(seen[k]) - p1) <= repeat_radius) {
+            continue;
+        }
+        // closer descriptors make better correspondences
+        int slot = store_.Offer(p0, p1, -matches[k].distance);
+        if (slot < 0) {
+            continue;
+        }
+        added.Push(p0, p1);
+        if (slot == descriptors_.rows) {
+            descriptors_.push_back(descriptors.row((int)k));
+            appended.push_back(descriptors.row((int)k));
+        }
+        else {
+            descriptors.row((int)k).copyTo(descriptors_.row(slot));
+        }
+    }
+    if (history_)
+    {
+        // replaced slots are stale in the index until it is rebuilt
+        if (store_.Replaced() - indexed_replaced_ > store_.Size() / 4) {
+            history_->Clear();
+            history_->Add(descriptors_);
+            indexed_replaced_ = store_.Replaced();
+        }
+        else {
+            history_->Add(appended);
+        }
+    }
+    // an explicit (and possibly refined) estimate holds until Reset
+    if (settings_.tolerance > 0 && online_.Update(points, added) && !estimated_) {
+        transform_ = online_.Transform();
+    }
+    if (settings_.refine) {
+        // frames go back to the capture, keep copies
+        for (int i = 0; i < 2; i++) {
+            cv::Mat gray;
+            ToGray(pair[i], gray);
+            gray.copyTo(last_[i]);
+        }
+    }
+}
+
+void CpuCalibrator::Matches(const std::vector<cv::Mat>& images, uint64_t sequence,
+    cv::Mat& matches_image)
+{
+    const PairFeatures& features = Features(images, sequence);
+    cv::drawMatches(images[0], features.keypoints[0], images[1], features.keypoints[1],
+        features.matches[0], matches_image);
+}
+
+void CpuCalibrator::Evaluate(cv::InputArrayOfArrays images, double& psnr, cv::Scalar& mssim,
+    cv::OutputArray stitched_image)
+{
+    std::vector<cv::Mat> pair;
+    images.getMatVector(pair);
+    const cv::Mat& base = pair[0];
+    cv::Matx33d transform = ScaleHomography(transform_, settings_.image_size, base.size());
+
+    // camera 1 resampled onto camera 0
+    evaluator_.Score(base, pair[1], transform, psnr, mssim);
+
+    if (stitched_image.needed()) {
+        stitched_image.create(base.size(), base.type());
+        cv::Mat stitched = stitched_image.getMat();
+        base.copyTo(stitched);
+        evaluator_.Blend(pair[1], transform, stitched);
+    }
+}
+
+bool CpuCalibrator::Estimate()
+{
+    const Correspondences& points = store_.Points();
+    if (points.Size() < 4) {
+        std::cerr << "Not enough correspondences to estimate (" << points.Size() << ")"
+            << std::endl;
+        return false;
+    }
+    std::vector<uchar> inliers;
+    cv::Matx33d transform;
+    if (!FindHomographyRansac(points, RansacSettings(), transform, &inliers)) {
+        std::cerr << "Failed to estimate transform from " << points.Size()
+            << " correspondences" << std::endl;
+        return false;
+    }
+    double before = 0, after = 0;
+    if (settings_.refine && !last_[0].empty() &&
+        RefineHomography(last_[0], last_[1], RefineSettings(), transform, &before, &after)) {
+        std::cout << "Refined on the last pair fed, intensity error " << before << " -> "
+            << after << std::endl;
+    }
+    transform_ = transform;
+    estimated_ = true;
+    std::cout << "Estimated transform from " << cv::countNonZero(inliers) << "/"
+        << points.Size() << " correspondences:\n" << cv::Mat(transform) << std::endl;
+    return true;
+}
+
+bool CpuCalibrator::Save()
+{
+    cv::FileStorage fs(settings_.calib_file, cv::FileStorage::WRITE);
+    if (!fs.isOpened()) {
+        std::cerr << "Failed to write " << settings_.calib_file << std::endl;
+        return false;
+    }
+    fs << "image_size" << settings_.full_size;
+    fs << "transform" << cv::Mat(ScaleHomography(transform_, settings_.image_size,
+        settings_.full_size));
+    std::cout << "Saved transform to " << settings_.calib_file << std::endl;
+    return true;
+}
+
+bool CpuCalibrator::Load()
+{
+    cv::FileStorage fs(settings_.calib_file, cv::FileStorage::READ);
+    if (!fs.isOpened()) {
+        return false;
+    }
+    cv::Size size;
+    cv::Mat transform;
+    fs["image_size"] >> size;
+    fs["transform"] >> transform;
+    if (transform.rows != 3 || transform.cols != 3) {
+        return false;
+    }
+    transform.convertTo(transform, CV_64F);
+    transform_ = ScaleHomography(cv::Matx33d(transform), size, settings_.image_size);
+    return true;
+}
+
+void CpuCalibrator::Reset()
+{
+    store_.Clear();
+    descriptors_.release();
+    indexed_replaced_ = 0;
+    last_[0].release();
+    last_[1].release();
+    if (history_) {
+        history_->Clear();
+    }
+    online_.Reset();
+    transform_ = cv::Matx33d::eye();
+    estimated_ = false;
+}
+
+} // namespace camerascalib
@@ -0,0 +1,75 @@
+#ifndef CAMERASCALIB_CPU_CALIBRATOR_H
+#define CAMERASCALIB_CPU_CALIBRATOR_H
+
+#include <opencv2/features2d.hpp>
+
+#include "calibrator.h"
+#include "correspondence_store.h"
+#include "feature_cache.h"
+#include "descriptor_index.h"
+#include "online_estimator.h"
+#include "evaluation.h"
+
+namespace camerascalib {
+
+// Calibrator on host images, for machines without a GPU: features are
+// detected on both cameras in parallel, matched with a ratio test (once per
+// pair, Feed and Matches share them through a FeatureCache), and the
+// homography from camera 0 to camera 1 is estimated with RANSAC over all
+// correspondences fed so far, on request and, unless the tolerance is 0,
+// online after every pair fed (see OnlineEstimator). An estimate on request
+// takes over from the online one until Reset. Evaluate warps at capture
+// size with the transform scaled up from the matching branch, over the
+// overlap only (see PairEvaluator). With refine set, Estimate follows RANSAC
+// with a direct alignment of the last pair fed (see RefineHomography).
+//
+// Correspondences are kept in a CorrespondenceStore, bounded and spread
+// evenly over camera 0, and those seen before are not offered again: the
+// camera 0 descriptors of the stored ones go into a DescriptorIndex, and a
+// new match whose nearest stored descriptor sits at the same place in both
+// cameras is a repeat. Memory and Estimate stay bounded however long the
+// session, and the history keeps what the rig has seen, not just its start.
+class CpuCalibrator : public Calibrator
+{
+public:
+    explicit CpuCalibrator(const Settings& settings);
+
+    bool OnGpu() const override { return false; }
+    bool FullSizeEvaluate() const override { return true; }
+
+    void Feed(cv::InputArrayOfArrays images, uint64_t sequence) override;
+    void Matches(const std::vector<cv::Mat>& images, uint64_t sequence,
+        cv::Mat& matches_image) override;
+    void Evaluate(cv::InputArrayOfArrays images, double& psnr, cv::Scalar& mssim,
+        cv::OutputArray stitched_image) override;
+    bool Estimate() override;
+    double Convergence() const override { return online_.Change(); }
+    bool Converged() const override { return online_.Converged(); }
+    bool Save() override;
+    void Reset() override;
+
+private:
+    // Features of the pair, detected and matched on first use
+    const PairFeatures& Features(const std::vector<cv::Mat>& images, uint64_t sequence);
+    void Detect(const std::vector<cv::Mat>& images, PairFeatures& features);
+    void Match(PairFeatures& features);
+    bool Load();
+
+    Settings settings_;
+    cv::Ptr<cv::Feature2D> detectors_[2];  // one per camera, so both run at once
+    cv::Ptr<cv::DescriptorMatcher> matcher_;
+    FeatureCache cache_;
+    CorrespondenceStore store_;
+    std::shared_ptr<DescriptorIndex> history_;  // camera 0 descriptors of store_, ids are slots
+    cv::Mat descriptors_;                       // camera 0 descriptor of each slot
+    uint64_t indexed_replaced_;                 // store_.Replaced() when history_ was rebuilt
+    OnlineEstimator online_;
+    PairEvaluator evaluator_;
+    cv::Mat last_[2];                       // gray copy of the last pair fed, for refine
+    cv::Matx33d transform_;                 // camera 0 to camera 1, at image_size
+    bool estimated_;                        // transform_ is from Estimate, online updates wait
+};
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_CPU_CALIBRATOR_H
@@ -0,0 +1,61 @@
+#include "cuda_calibrator.h"
+
+namespace camerascalib {
+
+static videostitcher::CamerasCalib::Settings calib_settings(const Calibrator::Settings& settings)
+{
+    videostitcher::CamerasCalib::Settings calib_settings;
+    calib_settings.calib_file = settings.calib_file;
+    calib_settings.image_size = settings.image_size;
+    calib_settings.match_mode = settings.match_mode;
+    return calib_settings;
+}
+
+CudaCalibrator::CudaCalibrator(const Settings& settings)
+    : calib_(calib_settings(settings))
+{
+}
+
+// videostitcher keeps no features between calls, so the sequence is unused
+void CudaCalibrator::Feed(cv::InputArrayOfArrays images, uint64_t)
+{
+    images.getGpuMatVector(images_);
+    calib_.Feed(images_);
+}
+
+void CudaCalibrator::Matches(const std::vector<cv::Mat>& images, uint64_t,
+    cv::Mat& matches_image)
+{
+    calib_.Matches(images, matches_image);
+}
+
+void CudaCalibrator::Evaluate(cv::InputArrayOfArrays images, double& psnr, cv::Scalar& mssim,
+    cv::OutputArray stitched_image)
+{
+    images.getGpuMatVector(images_);
+    if (stitched_image.needed()) {
+        calib_.Evaluate(images_, psnr, mssim, stitched_image.getGpuMatRef());
+    }
+    else {
+        calib_.Evaluate(images_, psnr, mssim, stitched_image_);
+    }
+}
+
+bool CudaCalibrator::Estimate()
+{
+    calib_.Estimate();
+    return true;
+}
+
+bool CudaCalibrator::Save()
+{
+    calib_.Save();
+    return true;
+}
+
+void CudaCalibrator::Reset()
+{
+    calib_.Reset();
+}
+
+} // namespace camerascalib
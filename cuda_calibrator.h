@@ -0,0 +1,39 @@
+#ifndef CAMERASCALIB_CUDA_CALIBRATOR_H
+#define CAMERASCALIB_CUDA_CALIBRATOR_H
+
+#include <opencv2/core/cuda.hpp>
+
+#include <videostitcher/cameras_calib.h>
+
+#include "calibrator.h"
+
+namespace camerascalib {
+
+// The videostitcher calibrator, on device images. It is handed one
+// resolution only, so it evaluates on the matching branch.
+class CudaCalibrator : public Calibrator
+{
+public:
+    explicit CudaCalibrator(const Settings& settings);
+
+    bool OnGpu() const override { return true; }
+    bool FullSizeEvaluate() const override { return false; }
+
+    void Feed(cv::InputArrayOfArrays images, uint64_t sequence) override;
+    void Matches(const std::vector<cv::Mat>& images, uint64_t sequence,
+        cv::Mat& matches_image) override;
+    void Evaluate(cv::InputArrayOfArrays images, double& psnr, cv::Scalar& mssim,
+        cv::OutputArray stitched_image) override;
+    bool Estimate() override;
+    bool Save() override;
+    void Reset() override;
+
+private:
+    videostitcher::CamerasCalib calib_;
+    std::vector<cv::cuda::GpuMat> images_;
+    cv::cuda::GpuMat stitched_image_;
+};
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_CUDA_CALIBRATOR_H
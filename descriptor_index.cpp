@@ -0,0 +1,167 @@
+#include "descriptor_index.h"
+
+#include <cfloat>
+#include <climits>
+#include <numeric>
+#include <algorithm>
+#include <unordered_map>
+
+#include <opencv2/core/utility.hpp>
+#include <opencv2/core/hal/hal.hpp>
+
+#include "capture_source.h"
+
+namespace camerascalib {
+
+// Multi-probe LSH: each table hashes a descriptor to the values of a fixed
+// random subset of its bits, and a query visits its own bucket plus those
+// whose keys are a few bit flips away, instead of needing many more tables
+class LshIndex : public DescriptorIndex
+{
+public:
+    explicit LshIndex(const IndexSettings& settings);
+
+    void Add(const cv::Mat& descriptors) override;
+    void Search(const cv::Mat& query, std::vector<int>& indices,
+        std::vector<float>& distances) const override;
+    size_t Size() const override { return (size_t)data_.rows; }
+    void Clear() override;
+
+private:
+    uint32_t Key(const uchar* descriptor, int table) const;
+
+    IndexSettings settings_;
+    cv::Mat data_;
+    std::vector<std::vector<int>> bits_;    // per table, the descriptor bits of its key
+    std::vector<std::unordered_map<uint32_t, std::vector<int>>> buckets_;
+    std::vector<uint32_t> probes_;          // key flips visited per table, none first
+};
+
+LshIndex::LshIndex(const IndexSettings& settings)
+    : settings_(settings)
+{
+    for (uint32_t mask = 0; mask < (1u << settings_.key_bits); mask++) {
+        if (__builtin_popcount(mask) <= settings_.probes) {
+            probes_.push_back(mask);
+        }
+    }
+    std::stable_sort(probes_.begin(), probes_.end(), [](uint32_t a, uint32_t b) {
+        return __builtin_popcount(a) < __builtin_popcount(b);
+    });
+    Clear();
+}
+
+void LshIndex::Clear()
+{
+    data_.release();
+    bits_.clear();
+    buckets_.assign(settings_.tables, std::unordered_map<uint32_t, std::vector<int>>());
+}
+
+uint32_t LshIndex::Key(const uchar* descriptor, int table) const
+{
+    uint32_t key = 0;
+    for (int b = 0; b < settings_.key_bits; b++) {
+        int bit = bits_[table][b];
+        key |= (uint32_t)((descriptor[bit >> 3] >> (bit & 7)) & 1) << b;
+    }
+    return key;
+}
+
+void LshIndex::Add(const cv::Mat& descriptors)
+{
+    if (descriptors.empty()) {
+        return;
+    }
+    CV_Assert(descriptors.type() == CV_8UC1 && (data_.empty() || descriptors.cols == data_.cols));
+    if (bits_.empty())
+    {
+        // the same bits every run, so results are repeatable
+        cv::RNG rng(0x15b);
+        int width = descriptors.cols * 8;
+        std::vector<int> all(width);
+        std::iota(all.begin(), all.end(), 0);
+        for (int t = 0; t < settings_.tables; t++) {
+            for (int b = 0; b < settings_.key_bits && b < width; b++) {
+                std::swap(all[b], all[b + rng.uniform(0, width - b)]);
+            }
+            bits_.push_back(std::vector<int>(all.begin(),
+                all.begin() + std::min(settings_.key_bits, width)));
+        }
+        settings_.key_bits = (int)bits_[0].size();
+    }
+
+    int first = data_.rows;
+    data_.push_back(descriptors);
+    cv::parallel_for_(cv::Range(0, settings_.tables), [&](const cv::Range& range) {
+        for (int t = range.start; t < range.end; t++) {
+            for (int id = first; id < data_.rows; id++) {
+                buckets_[t][Key(data_.ptr(id), t)].push_back(id);
+            }
+        }
+    });
+}
+
+void LshIndex::Search(const cv::Mat& query, std::vector<int>& indices,
+    std::vector<float>& distances) const
+{
+    indices.assign(query.rows, -1);
+    distances.assign(query.rows, FLT_MAX);
+    if (data_.empty() || query.empty()) {
+        return;
+    }
+    CV_Assert(query.type() == CV_8UC1 && query.cols == data_.cols);
+
+    cv::parallel_for_(cv::Range(0, query.rows), [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; i++)
+        {
+            const uchar* q = query.ptr(i);
+            int best = -1;
+            int best_distance = INT_MAX;
+            for (int t = 0; t < settings_.tables; t++)
+            {
+                uint32_t key = Key(q, t);
+                for (uint32_t flip : probes_)
+                {
+                    auto bucket = buckets_[t].find(key ^ flip);
+                    if (bucket == buckets_[t].end()) {
+                        continue;
+                    }
+                    for (int id : bucket->second) {
+                        int distance = cv::hal::normHamming(q, data_.ptr(id), data_.cols);
+                        if (distance < best_distance) {
+                            best_distance = distance;
+                            best = id;
+                        }
+                    }
+                }
+            }
+            if (best >= 0) {
+                indices[i] = best;
+                distances[i] = (float)best_distance;
+            }
+        }
+    });
+}
+
+std::shared_ptr<DescriptorIndex> CreateDescriptorIndex(int type, const IndexSettings& settings)
+{
+    if (type == CV_8UC1) {
+        return std::make_shared<LshIndex>(settings);
+    }
+    return nullptr;
+}
+
+bool ParseIndexSettings(const std::string& spec, IndexSettings& settings)
+{
+    if (!ParseKeyValues<int>(spec, {
+            { "tables", &settings.tables }, { "bits", &settings.key_bits },
+            { "probes", &settings.probes },
+        })) {
+        return false;
+    }
+    return settings.tables > 0 && settings.key_bits > 0 && settings.key_bits <= 24 &&
+        settings.probes >= 0 && settings.probes <= 3;
+}
+
+} // namespace camerascalib
@@ -0,0 +1,51 @@
+#ifndef CAMERASCALIB_DESCRIPTOR_INDEX_H
+#define CAMERASCALIB_DESCRIPTOR_INDEX_H
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <opencv2/core/core.hpp>
+
+namespace camerascalib {
+
+// Recall against speed of the approximate search; more tables or probes
+// find the true nearest neighbour more often, slower
+struct IndexSettings
+{
+    // multi-probe LSH over binary descriptors
+    int tables = 6;         // hash tables, each on its own random bits
+    int key_bits = 16;      // descriptor bits per hash key
+    int probes = 1;         // also visit buckets whose key differs in up to this many bits
+};
+
+// Approximate nearest neighbour index over descriptors added a batch at a
+// time, so a growing history can be searched without rebuilding anything.
+// Rows get ids in the order they are added, from 0.
+class DescriptorIndex
+{
+public:
+    virtual ~DescriptorIndex() {}
+
+    virtual void Add(const cv::Mat& descriptors) = 0;
+
+    // Approximate nearest row for each query row, -1 where nothing was found,
+    // with its Hamming distance.
+    // Query rows are searched in parallel.
+    virtual void Search(const cv::Mat& query, std::vector<int>& indices,
+        std::vector<float>& distances) const = 0;
+
+    virtual size_t Size() const = 0;
+    virtual void Clear() = 0;
+};
+
+// Multi-probe LSH for CV_8U (binary) descriptors, which every match mode
+// produces; nullptr for anything else
+std::shared_ptr<DescriptorIndex> CreateDescriptorIndex(int type, const IndexSettings& settings);
+
+// Parse a key=value list (tables, bits, probes) over the defaults
+bool ParseIndexSettings(const std::string& spec, IndexSettings& settings);
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_DESCRIPTOR_INDEX_H
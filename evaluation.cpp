@@ -0,0 +1,234 @@
+#include "evaluation.h"
+
+#include <cmath>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+
+#include <opencv2/core/utility.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace camerascalib {
+
+static const int ssim_radius = 3;  // 7x7 windows
+
+static void overlap_mask(const cv::Matx33d& transform, cv::Size size, cv::Size image_size,
+    cv::Mat& mask)
+{
+    std::vector<cv::Point2f> corners = { cv::Point2f(0, 0), cv::Point2f((float)image_size.width, 0),
+        cv::Point2f((float)image_size.width, (float)image_size.height),
+        cv::Point2f(0, (float)image_size.height) };
+    cv::perspectiveTransform(corners, corners, cv::Mat(transform.inv()));
+    std::vector<cv::Point> polygon;
+    for (const cv::Point2f& corner : corners) {
+        polygon.push_back(cv::Point(cvRound(corner.x), cvRound(corner.y)));
+    }
+    mask = cv::Mat::zeros(size, CV_8UC1);
+    cv::fillConvexPoly(mask, polygon, cv::Scalar(255));
+}
+
+// rect grown out to multiples of step, within size
+static cv::Rect align(const cv::Rect& rect, int step, cv::Size size)
+{
+    int x0 = rect.x / step * step;
+    int y0 = rect.y / step * step;
+    int x1 = std::min(size.width, (rect.x + rect.width + step - 1) / step * step);
+    int y1 = std::min(size.height, (rect.y + rect.height + step - 1) / step * step);
+    return cv::Rect(x0, y0, std::max(0, x1 - x0), std::max(0, y1 - y0));
+}
+
+static cv::Size scaled(cv::Size size, int step)
+{
+    return cv::Size(std::max(1, (size.width + step / 2) / step),
+        std::max(1, (size.height + step / 2) / step));
+}
+
+// full resolution coordinates to those of rect at 1/step
+static cv::Matx33d to_roi(const cv::Rect& rect, int step)
+{
+    double s = 1.0 / step;
+    return cv::Matx33d(s, 0, -s * rect.x, 0, s, -s * rect.y, 0, 0, 1);
+}
+
+// Fixed point remap tables resampling through transform onto size
+static void build_maps(const cv::Matx33d& transform, cv::Size size, cv::Mat& map1, cv::Mat& map2)
+{
+    cv::Mat positions(size, CV_32FC2), mapped;
+    for (int y = 0; y < size.height; y++) {
+        cv::Vec2f* row = positions.ptr<cv::Vec2f>(y);
+        for (int x = 0; x < size.width; x++) {
+            row[x] = cv::Vec2f((float)x, (float)y);
+        }
+    }
+    cv::perspectiveTransform(positions, mapped, cv::Mat(transform));
+    cv::convertMaps(mapped, cv::noArray(), map1, map2, CV_16SC2);
+}
+
+static void shrink(const cv::Mat& src, cv::Size size, cv::Mat& dst)
+{
+    if (src.size() == size) {
+        dst = src;
+    }
+    else {
+        cv::resize(src, dst, size, 0, 0, cv::INTER_AREA);
+    }
+}
+
+PairEvaluator::PairEvaluator(int level)
+    : level_(std::max(0, level))
+    , valid_(false)
+{
+}
+
+void PairEvaluator::Update(cv::Size base_size, cv::Size image_size, const cv::Matx33d& transform)
+{
+    if (valid_ && transform == transform_ && base_size == base_size_ &&
+        image_size == image_size_) {
+        return;
+    }
+    valid_ = true;
+    transform_ = transform;
+    base_size_ = base_size;
+    image_size_ = image_size;
+
+    map1_.release();
+    map2_.release();
+    overlap_mask(transform, base_size, image_size, mask_);
+    bounds_ = cv::boundingRect(mask_);
+    int step = 1 << level_;
+    roi_ = align(bounds_, step, base_size);
+    if (roi_.area() == 0) {
+        image_roi_ = cv::Rect();
+        return;
+    }
+
+    // the part of the image the overlap samples, with a margin for interpolation
+    std::vector<cv::Point2f> corners = { cv::Point2f((float)roi_.x, (float)roi_.y),
+        cv::Point2f((float)roi_.br().x, (float)roi_.y),
+        cv::Point2f((float)roi_.br().x, (float)roi_.br().y),
+        cv::Point2f((float)roi_.x, (float)roi_.br().y) };
+    cv::perspectiveTransform(corners, corners, cv::Mat(transform));
+    cv::Rect sampled = cv::boundingRect(corners);
+    sampled -= cv::Point(2 * step, 2 * step);
+    sampled += cv::Size(4 * step, 4 * step);
+    image_roi_ = align(sampled & cv::Rect(cv::Point(), image_size), step, image_size);
+
+    cv::resize(mask_(roi_), roi_mask_, scaled(roi_.size(), step), 0, 0, cv::INTER_NEAREST);
+    image_roi_size_ = scaled(image_roi_.size(), step);
+    roi_transform_ = to_roi(image_roi_, step) * transform * to_roi(roi_, step).inv();
+    build_maps(roi_transform_, roi_mask_.size(), roi_map1_, roi_map2_);
+}
+
+bool PairEvaluator::Score(const cv::Mat& base, const cv::Mat& image,
+    const cv::Matx33d& transform, double& psnr, cv::Scalar& mssim)
+{
+    Update(base.size(), image.size(), transform);
+    psnr = 0;
+    mssim = cv::Scalar();
+    if (roi_.area() == 0 || image_roi_.area() == 0) {
+        return false;
+    }
+
+    cv::Mat small_base, small_image, warped;
+    shrink(base(roi_), roi_mask_.size(), small_base);
+    shrink(image(image_roi_), image_roi_size_, small_image);
+    cv::remap(small_image, warped, roi_map1_, roi_map2_, cv::INTER_LINEAR);
+    psnr = MaskedPsnr(small_base, warped, roi_mask_);
+    mssim = MaskedSsim(small_base, warped, roi_mask_);
+    return true;
+}
+
+void PairEvaluator::Blend(const cv::Mat& image, const cv::Matx33d& transform, cv::Mat& stitched)
+{
+    Update(stitched.size(), image.size(), transform);
+    if (bounds_.area() == 0) {
+        return;
+    }
+    // only the bounding box of the overlap is resampled
+    if (map1_.empty()) {
+        cv::Matx33d shift(1, 0, bounds_.x, 0, 1, bounds_.y, 0, 0, 1);
+        build_maps(transform * shift, bounds_.size(), map1_, map2_);
+    }
+    cv::Mat warped, blend;
+    cv::remap(image, warped, map1_, map2_, cv::INTER_LINEAR);
+    cv::Mat target = stitched(bounds_);
+    cv::addWeighted(target, 0.5, warped, 0.5, 0, blend);
+    blend.copyTo(target, mask_(bounds_));
+}
+
+double MaskedPsnr(const cv::Mat& a, const cv::Mat& b, const cv::Mat& mask)
+{
+    int count = cv::countNonZero(mask);
+    if (count == 0) {
+        return 0;
+    }
+    // the unused byte of BGRx is the same in both and not a channel
+    double mse = cv::norm(a, b, cv::NORM_L2SQR, mask) / ((double)count * std::min(a.channels(), 3));
+    if (mse <= 1e-10) {
+        return 100;
+    }
+    return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+// Sum of the window [top, bottom) x [left, right) of channel c of an integral image
+static inline double window_sum(const cv::Mat& sum, int top, int left, int bottom, int right,
+    int channels, int c)
+{
+    const double* t = sum.ptr<double>(top);
+    const double* b = sum.ptr<double>(bottom);
+    return b[right * channels + c] - b[left * channels + c] -
+        t[right * channels + c] + t[left * channels + c];
+}
+
+cv::Scalar MaskedSsim(const cv::Mat& a, const cv::Mat& b, const cv::Mat& mask)
+{
+    const double c1 = 6.5025, c2 = 58.5225;
+    const int channels = std::min(a.channels(), 4);
+
+    cv::Mat x, y, sum_x, sum_xx, sum_y, sum_yy, sum_xy;
+    a.convertTo(x, CV_32F);
+    b.convertTo(y, CV_32F);
+    cv::integral(x, sum_x, sum_xx, CV_64F, CV_64F);
+    cv::integral(y, sum_y, sum_yy, CV_64F, CV_64F);
+    cv::integral(x.mul(y), sum_xy, CV_64F);
+
+    std::mutex lock;
+    cv::Scalar total;
+    double count = 0;
+    cv::parallel_for_(cv::Range(0, a.rows), [&](const cv::Range& range) {
+        cv::Scalar partial;
+        double partial_count = 0;
+        for (int r = range.start; r < range.end; r++)
+        {
+            const uchar* m = mask.ptr(r);
+            int top = std::max(0, r - ssim_radius);
+            int bottom = std::min(a.rows, r + ssim_radius + 1);
+            for (int col = 0; col < a.cols; col++)
+            {
+                if (!m[col]) {
+                    continue;
+                }
+                int left = std::max(0, col - ssim_radius);
+                int right = std::min(a.cols, col + ssim_radius + 1);
+                double n = (double)(bottom - top) * (right - left);
+                for (int c = 0; c < channels; c++)
+                {
+                    double mx = window_sum(sum_x, top, left, bottom, right, channels, c) / n;
+                    double my = window_sum(sum_y, top, left, bottom, right, channels, c) / n;
+                    double vx = window_sum(sum_xx, top, left, bottom, right, channels, c) / n - mx * mx;
+                    double vy = window_sum(sum_yy, top, left, bottom, right, channels, c) / n - my * my;
+                    double cxy = window_sum(sum_xy, top, left, bottom, right, channels, c) / n - mx * my;
+                    partial[c] += (2 * mx * my + c1) * (2 * cxy + c2) /
+                        ((mx * mx + my * my + c1) * (vx + vy + c2));
+                }
+                partial_count++;
+            }
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        total += partial;
+        count += partial_count;
+    });
+    return count > 0 ? total * (1.0 / count) : cv::Scalar();
+}
+
+} // namespace camerascalib
@@ -0,0 +1,56 @@
+#ifndef CAMERASCALIB_EVALUATION_H
+#define CAMERASCALIB_EVALUATION_H
+
+#include <opencv2/core/core.hpp>
+
+namespace camerascalib {
+
+// Scores and stitches one camera onto the base camera through a transform
+// (base to image coordinates, dst(x) = image(H x)). Everything that depends
+// only on the transform and the image sizes, the overlap mask, the bounding
+// boxes of the overlap in both images and the remap tables of the warps, is
+// cached and rebuilt when either changes, so per frame only the overlap is
+// resampled, by a fixed point table lookup (cv::remap on CV_16SC2 positions
+// and interpolation weights), and scored. Scores are taken level pyramid
+// levels down, at 1/2^level resolution.
+class PairEvaluator
+{
+public:
+    explicit PairEvaluator(int level = 0);
+
+    // PSNR and SSIM over the overlap; false, and zeros, if there is none
+    bool Score(const cv::Mat& base, const cv::Mat& image, const cv::Matx33d& transform,
+        double& psnr, cv::Scalar& mssim);
+
+    // Blend image half and half into stitched, a copy of the base, over the overlap
+    void Blend(const cv::Mat& image, const cv::Matx33d& transform, cv::Mat& stitched);
+
+private:
+    void Update(cv::Size base_size, cv::Size image_size, const cv::Matx33d& transform);
+
+    int level_;
+    bool valid_;
+    cv::Matx33d transform_;
+    cv::Size base_size_;
+    cv::Size image_size_;
+    cv::Mat mask_;                  // overlap, full resolution
+    cv::Rect bounds_;               // of mask_
+    cv::Rect roi_;                  // bounds_ aligned to the level, in the base
+    cv::Rect image_roi_;            // what roi_ maps to, in the image
+    cv::Mat roi_mask_;              // mask_ over roi_, at the level
+    cv::Size image_roi_size_;       // image_roi_ at the level
+    cv::Matx33d roi_transform_;     // roi_ to image_roi_, at the level
+    cv::Mat roi_map1_, roi_map2_;   // remap tables of roi_transform_
+    cv::Mat map1_, map2_;           // remap tables over bounds_, built on first Blend
+};
+
+// PSNR over the pixels set in mask, 0 if there are none
+double MaskedPsnr(const cv::Mat& a, const cv::Mat& b, const cv::Mat& mask);
+
+// SSIM (Wang et al. 2004) averaged over mask, per channel, with 7x7 box
+// windows summed from integral images, so only masked pixels cost anything
+cv::Scalar MaskedSsim(const cv::Mat& a, const cv::Mat& b, const cv::Mat& mask);
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_EVALUATION_H
@@ -0,0 +1,42 @@
+#include "feature_cache.h"
+
+namespace camerascalib {
+
+FeatureCache::FeatureCache(size_t capacity, int cameras, int pairs)
+    : entries_(capacity)
+    , valid_(capacity, false)
+    , cameras_(cameras)
+    , pairs_(pairs)
+    , next_(0)
+{
+}
+
+const PairFeatures* FeatureCache::Find(uint64_t sequence) const
+{
+    for (size_t i = 0; i < entries_.size(); i++) {
+        if (valid_[i] && entries_[i].sequence == sequence) {
+            return &entries_[i];
+        }
+    }
+    return nullptr;
+}
+
+PairFeatures& FeatureCache::Insert(uint64_t sequence)
+{
+    PairFeatures& entry = entries_[next_];
+    valid_[next_] = true;
+    next_ = (next_ + 1) % entries_.size();
+    entry.sequence = sequence;
+    entry.keypoints.resize(cameras_);
+    entry.descriptors.resize(cameras_);
+    entry.matches.resize(pairs_);
+    for (std::vector<cv::KeyPoint>& keypoints : entry.keypoints) {
+        keypoints.clear();
+    }
+    for (std::vector<cv::DMatch>& matches : entry.matches) {
+        matches.clear();
+    }
+    return entry;
+}
+
+} // namespace camerascalib
@@ -0,0 +1,46 @@
+#ifndef CAMERASCALIB_FEATURE_CACHE_H
+#define CAMERASCALIB_FEATURE_CACHE_H
+
+#include <vector>
+#include <cstdint>
+
+#include <opencv2/core/core.hpp>
+
+namespace camerascalib {
+
+// Keypoints and descriptors of every camera of one synchronised set of
+// frames (a pair, for two cameras), and the matches of each camera pair the
+// owner matches, the first camera of the pair as query
+struct PairFeatures
+{
+    uint64_t sequence = 0;
+    std::vector<std::vector<cv::KeyPoint>> keypoints;   // per camera
+    std::vector<cv::Mat> descriptors;
+    std::vector<std::vector<cv::DMatch>> matches;       // per camera pair
+};
+
+// Features of the last few pairs by sequence number, so detection and
+// matching run once per pair however many consumers read them. Entries are
+// recycled oldest first and keep their buffers.
+class FeatureCache
+{
+public:
+    explicit FeatureCache(size_t capacity = 4, int cameras = 2, int pairs = 1);
+
+    // The entry of sequence, or nullptr
+    const PairFeatures* Find(uint64_t sequence) const;
+
+    // The entry to fill for sequence, replacing the oldest one
+    PairFeatures& Insert(uint64_t sequence);
+
+private:
+    std::vector<PairFeatures> entries_;
+    std::vector<bool> valid_;
+    int cameras_;
+    int pairs_;
+    size_t next_;
+};
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_FEATURE_CACHE_H
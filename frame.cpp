@@ -0,0 +1,168 @@
+#include "frame.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace camerascalib {
+
+const char* PixelFormatName(PixelFormat format)
+{
+    switch (format)
+    {
+    case PIXEL_FORMAT_GRAY:
+        return "GRAY8";
+    case PIXEL_FORMAT_BGR:
+        return "BGR";
+    case PIXEL_FORMAT_BGRX:
+        return "BGRx";
+    case PIXEL_FORMAT_NV12:
+        return "NV12";
+    default:
+        return "unknown";
+    }
+}
+
+bool ParsePixelFormat(const std::string& name, PixelFormat& format)
+{
+    if (name == "gray") {
+        format = PIXEL_FORMAT_GRAY;
+    }
+    else if (name == "bgr") {
+        format = PIXEL_FORMAT_BGR;
+    }
+    else if (name == "bgrx") {
+        format = PIXEL_FORMAT_BGRX;
+    }
+    else if (name == "nv12") {
+        format = PIXEL_FORMAT_NV12;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+PixelFormat DetectPixelFormat(const cv::Mat& image, cv::Size size)
+{
+    if (image.depth() != CV_8U) {
+        return PIXEL_FORMAT_UNKNOWN;
+    }
+    switch (image.channels())
+    {
+    case 1:
+        if (image.cols == size.width && image.rows == size.height * 3 / 2) {
+            return PIXEL_FORMAT_NV12;
+        }
+        return PIXEL_FORMAT_GRAY;
+    case 3:
+        return PIXEL_FORMAT_BGR;
+    case 4:
+        return PIXEL_FORMAT_BGRX;
+    default:
+        return PIXEL_FORMAT_UNKNOWN;
+    }
+}
+
+void ToBgr(const Frame& frame, cv::Mat& bgr)
+{
+    switch (frame.format)
+    {
+    case PIXEL_FORMAT_BGRX:
+        cv::cvtColor(frame.image, bgr, cv::COLOR_BGRA2BGR);
+        break;
+    case PIXEL_FORMAT_NV12:
+        cv::cvtColor(frame.image, bgr, cv::COLOR_YUV2BGR_NV12);
+        break;
+    case PIXEL_FORMAT_GRAY:
+        cv::cvtColor(frame.image, bgr, cv::COLOR_GRAY2BGR);
+        break;
+    default:
+        bgr = frame.image;
+        break;
+    }
+}
+
+void ScaleFrame(const Frame& frame, cv::Size size, cv::Mat& scaled)
+{
+    if (frame.format != PIXEL_FORMAT_NV12) {
+        cv::resize(frame.image, scaled, size, 0, 0, cv::INTER_AREA);
+        return;
+    }
+
+    int height = frame.image.rows * 2 / 3;
+    scaled.create(size.height * 3 / 2, size.width, CV_8UC1);
+    cv::Mat y = scaled.rowRange(0, size.height);
+    cv::resize(frame.image.rowRange(0, height), y, size, 0, 0, cv::INTER_AREA);
+    cv::Mat uv(size.height / 2, size.width / 2, CV_8UC2, scaled.ptr(size.height), scaled.step);
+    cv::resize(cv::Mat(height / 2, frame.image.cols / 2, CV_8UC2,
+        const_cast<uchar*>(frame.image.ptr(height)), frame.image.step),
+        uv, uv.size(), 0, 0, cv::INTER_AREA);
+}
+
+Frame MatchingBranch(const Frame& frame)
+{
+    Frame branch = frame;
+    if (!frame.scaled.empty()) {
+        branch.image = frame.scaled;
+        branch.scaled.release();
+    }
+    return branch;
+}
+
+void ToLuma(const Frame& frame, cv::Mat& luma)
+{
+    switch (frame.format)
+    {
+    case PIXEL_FORMAT_NV12:
+        luma = frame.image.rowRange(0, frame.image.rows * 2 / 3);
+        break;
+    case PIXEL_FORMAT_BGRX:
+        cv::cvtColor(frame.image, luma, cv::COLOR_BGRA2GRAY);
+        break;
+    case PIXEL_FORMAT_BGR:
+        cv::cvtColor(frame.image, luma, cv::COLOR_BGR2GRAY);
+        break;
+    default:
+        luma = frame.image;
+        break;
+    }
+}
+
+void FromBgr(const cv::Mat& bgr, PixelFormat format, cv::Mat& image)
+{
+    switch (format)
+    {
+    case PIXEL_FORMAT_GRAY:
+        cv::cvtColor(bgr, image, cv::COLOR_BGR2GRAY);
+        break;
+    case PIXEL_FORMAT_BGRX:
+        cv::cvtColor(bgr, image, cv::COLOR_BGR2BGRA);
+        break;
+    case PIXEL_FORMAT_NV12:
+        {
+            // OpenCV only writes planar I420, interleave its chroma planes
+            cv::Mat i420;
+            cv::cvtColor(bgr, i420, cv::COLOR_BGR2YUV_I420);
+            int width = bgr.cols;
+            int height = bgr.rows;
+            image.create(height * 3 / 2, width, CV_8UC1);
+            i420.rowRange(0, height).copyTo(image.rowRange(0, height));
+            const uchar* u = i420.ptr(height);
+            const uchar* v = u + (width / 2) * (height / 2);
+            for (int y = 0; y < height / 2; y++)
+            {
+                uchar* uv = image.ptr(height + y);
+                for (int x = 0; x < width / 2; x++)
+                {
+                    uv[2 * x] = *u++;
+                    uv[2 * x + 1] = *v++;
+                }
+            }
+        }
+        break;
+    default:
+        image = bgr;
+        break;
+    }
+}
+
+} // namespace camerascalib
@@ -0,0 +1,70 @@
+#ifndef CAMERASCALIB_FRAME_H
+#define CAMERASCALIB_FRAME_H
+
+#include <cstdint>
+#include <chrono>
+#include <string>
+
+#include <opencv2/core/core.hpp>
+
+namespace camerascalib {
+
+// Pixel layout of a frame as delivered by its capture source
+enum PixelFormat
+{
+    PIXEL_FORMAT_UNKNOWN,
+    PIXEL_FORMAT_GRAY,      // CV_8UC1
+    PIXEL_FORMAT_BGR,       // CV_8UC3
+    PIXEL_FORMAT_BGRX,      // CV_8UC4, alpha byte unused
+    PIXEL_FORMAT_NV12       // CV_8UC1, height * 3 / 2 rows: Y plane then interleaved UV
+};
+
+const char* PixelFormatName(PixelFormat format);
+bool ParsePixelFormat(const std::string& name, PixelFormat& format);
+
+// Tell the layout of an image delivered for frames of the given size from
+// its shape, for backends that do not report what they negotiated
+PixelFormat DetectPixelFormat(const cv::Mat& image, cv::Size size);
+
+// One image from one camera, stamped on the moment it left the capture
+struct Frame
+{
+    cv::Mat image;
+    int64_t timestamp = 0;  // nanoseconds on the monotonic clock
+    int64_t arrival = 0;    // MonotonicNs() when the capture thread received it, also for
+                            // replayed and synthetic frames, whose timestamps are their own
+    uint64_t sequence = 0;  // per-camera frame counter
+    PixelFormat format = PIXEL_FORMAT_UNKNOWN;
+    cv::Mat scaled;         // downscaled matching branch in the same format, if enabled
+};
+
+// Resize a frame's image to size in one pass, keeping its pixel format
+// (both planes of NV12 are resized). size must be even for NV12.
+void ScaleFrame(const Frame& frame, cv::Size size, cv::Mat& scaled);
+
+// The frame the matching stages work on: the downscaled branch when there
+// is one, the full resolution frame otherwise
+Frame MatchingBranch(const Frame& frame);
+
+// Convert a frame to BGR in a single pass. BGR frames are shared, not copied,
+// so this costs nothing unless the capture delivers another layout.
+void ToBgr(const Frame& frame, cv::Mat& bgr);
+
+// Intensity of a frame for the feature path. NV12 and gray frames give a view
+// of their Y plane without copying, colour layouts take one conversion.
+void ToLuma(const Frame& frame, cv::Mat& luma);
+
+// Produce an image in the given layout from a BGR one, for sources that
+// render or decode BGR but should look like a camera delivering another format
+void FromBgr(const cv::Mat& bgr, PixelFormat format, cv::Mat& image);
+
+// Monotonic clock shared by all capture threads, in nanoseconds
+inline int64_t MonotonicNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_FRAME_H
@@ -0,0 +1,103 @@
+#include "frame_ring.h"
+
+namespace camerascalib {
+
+FrameRing::FrameRing(size_t capacity)
+    : slots_(capacity > 0 ? capacity : 1)
+    , head_(0)
+    , count_(0)
+    , closed_(false)
+    , overwritten_(0)
+{
+}
+
+void FrameRing::Reset(size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    slots_.assign(capacity > 0 ? capacity : 1, Frame());
+    head_ = 0;
+    count_ = 0;
+    closed_ = false;
+    overwritten_ = 0;
+}
+
+bool FrameRing::Push(Frame frame, bool block)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (block) {
+        not_full_.wait(lock, [this] { return closed_ || count_ < slots_.size(); });
+    }
+    if (closed_) {
+        return false;
+    }
+
+    if (count_ == slots_.size()) {
+        // drop the oldest frame to make room for the freshest one
+        head_ = (head_ + 1) % slots_.size();
+        --count_;
+        ++overwritten_;
+    }
+    slots_[(head_ + count_) % slots_.size()] = std::move(frame);
+    ++count_;
+    lock.unlock();
+    not_empty_.notify_one();
+    return true;
+}
+
+bool FrameRing::WaitFront(Frame& frame, int timeout_ms)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!not_empty_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+            [this] { return closed_ || count_ > 0; })) {
+        return false;
+    }
+    if (count_ == 0) {
+        return false;
+    }
+    frame = slots_[head_];
+    return true;
+}
+
+bool FrameRing::PopFront(uint64_t sequence)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (count_ == 0 || slots_[head_].sequence != sequence) {
+        return false;
+    }
+    slots_[head_].image.release();
+    head_ = (head_ + 1) % slots_.size();
+    --count_;
+    lock.unlock();
+    not_full_.notify_one();
+    return true;
+}
+
+void FrameRing::Close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+    }
+    not_empty_.notify_all();
+    not_full_.notify_all();
+}
+
+bool FrameRing::Closed() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return closed_;
+}
+
+size_t FrameRing::Size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return count_;
+}
+
+unsigned long FrameRing::Overwritten() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return overwritten_;
+}
+
+} // namespace camerascalib
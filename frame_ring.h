@@ -0,0 +1,54 @@
+#ifndef CAMERASCALIB_FRAME_RING_H
+#define CAMERASCALIB_FRAME_RING_H
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+#include "frame.h"
+
+namespace camerascalib {
+
+// Fixed-size ring of frames between one capture thread and the pairing stage.
+// The slots are allocated once; a live producer overwrites the oldest frame
+// when the consumer falls behind, a blocking producer waits for room instead.
+class FrameRing
+{
+public:
+    explicit FrameRing(size_t capacity);
+
+    // Drop all frames and change the capacity. Not safe while in use.
+    void Reset(size_t capacity);
+
+    // Append a frame. Returns false if the ring has been closed.
+    bool Push(Frame frame, bool block);
+
+    // Copy the oldest frame without removing it, waiting up to timeout_ms.
+    bool WaitFront(Frame& frame, int timeout_ms);
+
+    // Remove the oldest frame if it is still the one with this sequence
+    // number (it may have been overwritten since it was peeked).
+    bool PopFront(uint64_t sequence);
+
+    // Wake up all waiters and refuse further frames.
+    void Close();
+
+    bool Closed() const;
+    size_t Size() const;
+    size_t Capacity() const { return slots_.size(); }
+    unsigned long Overwritten() const;
+
+private:
+    std::vector<Frame> slots_;
+    size_t head_;
+    size_t count_;
+    bool closed_;
+    unsigned long overwritten_;
+    mutable std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+};
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_FRAME_RING_H
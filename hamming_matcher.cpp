@@ -0,0 +1,191 @@
+#include "hamming_matcher.h"
+
+#include <cstring>
+#include <climits>
+#include <algorithm>
+
+#include <opencv2/core/utility.hpp>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace camerascalib {
+
+static const int descriptor_bytes = 32;
+static const int query_block = 64;     // query rows per thread work item
+static const int train_tile = 512;     // train rows per pass, 16 KB, stays in L1
+
+// Distances from one query descriptor to count train descriptors step bytes apart
+typedef void (*DistanceKernel)(const uchar* query, const uchar* train, size_t step, int count,
+    int* distances);
+
+static void distances_generic(const uchar* query, const uchar* train, size_t step, int count,
+    int* distances)
+{
+    uint64_t q[4];
+    std::memcpy(q, query, descriptor_bytes);
+    for (int j = 0; j < count; j++, train += step)
+    {
+        uint64_t t[4];
+        std::memcpy(t, train, descriptor_bytes);
+        distances[j] = __builtin_popcountll(q[0] ^ t[0]) + __builtin_popcountll(q[1] ^ t[1]) +
+            __builtin_popcountll(q[2] ^ t[2]) + __builtin_popcountll(q[3] ^ t[3]);
+    }
+}
+
+#if defined(__x86_64__)
+__attribute__((target("popcnt")))
+static void distances_popcnt(const uchar* query, const uchar* train, size_t step, int count,
+    int* distances)
+{
+    uint64_t q[4];
+    std::memcpy(q, query, descriptor_bytes);
+    for (int j = 0; j < count; j++, train += step)
+    {
+        uint64_t t[4];
+        std::memcpy(t, train, descriptor_bytes);
+        distances[j] = (int)(_mm_popcnt_u64(q[0] ^ t[0]) + _mm_popcnt_u64(q[1] ^ t[1]) +
+            _mm_popcnt_u64(q[2] ^ t[2]) + _mm_popcnt_u64(q[3] ^ t[3]));
+    }
+}
+
+// A whole descriptor per register; bits are counted per nibble with a
+// shuffle lookup and summed per 64 bit lane with sad
+__attribute__((target("avx2")))
+static void distances_avx2(const uchar* query, const uchar* train, size_t step, int count,
+    int* distances)
+{
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    const __m256i q = _mm256_loadu_si256((const __m256i*)query);
+    for (int j = 0; j < count; j++, train += step)
+    {
+        __m256i x = _mm256_xor_si256(q, _mm256_loadu_si256((const __m256i*)train));
+        __m256i bits = _mm256_add_epi8(
+            _mm256_shuffle_epi8(lookup, _mm256_and_si256(x, nibble)),
+            _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble)));
+        __m256i sums = _mm256_sad_epu8(bits, _mm256_setzero_si256());
+        __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sums),
+            _mm256_extracti128_si256(sums, 1));
+        distances[j] = (int)(_mm_cvtsi128_si64(half) + _mm_extract_epi64(half, 1));
+    }
+}
+#endif
+
+#if defined(__aarch64__)
+static void distances_neon(const uchar* query, const uchar* train, size_t step, int count,
+    int* distances)
+{
+    const uint8x16_t q0 = vld1q_u8(query);
+    const uint8x16_t q1 = vld1q_u8(query + 16);
+    for (int j = 0; j < count; j++, train += step)
+    {
+        // at most 16 bits per byte lane, so the sum fits the widening add
+        uint8x16_t bits = vaddq_u8(vcntq_u8(veorq_u8(q0, vld1q_u8(train))),
+            vcntq_u8(veorq_u8(q1, vld1q_u8(train + 16))));
+        distances[j] = vaddlvq_u8(bits);
+    }
+}
+#endif
+
+struct Kernel
+{
+    DistanceKernel distances;
+    const char* name;
+};
+
+static Kernel select_kernel()
+{
+#if defined(__aarch64__)
+    return Kernel{ distances_neon, "neon" };
+#else
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2")) {
+        return Kernel{ distances_avx2, "avx2" };
+    }
+    if (__builtin_cpu_supports("popcnt")) {
+        return Kernel{ distances_popcnt, "popcnt" };
+    }
+#endif
+    return Kernel{ distances_generic, "generic" };
+#endif
+}
+
+static const Kernel& kernel()
+{
+    static const Kernel selected = select_kernel();
+    return selected;
+}
+
+const char* HammingKernel()
+{
+    return kernel().name;
+}
+
+bool HammingMatchable(const cv::Mat& descriptors)
+{
+    return descriptors.type() == CV_8UC1 && descriptors.cols == descriptor_bytes;
+}
+
+void HammingRatioMatch(const cv::Mat& query, const cv::Mat& train,
+    std::vector<cv::DMatch>& matches, float ratio)
+{
+    matches.clear();
+    // the ratio test needs a second best candidate
+    if (query.empty() || train.rows < 2) {
+        return;
+    }
+    CV_Assert(HammingMatchable(query) && HammingMatchable(train));
+
+    DistanceKernel distances = kernel().distances;
+    std::vector<cv::DMatch> found(query.rows);
+    int blocks = (query.rows + query_block - 1) / query_block;
+    cv::parallel_for_(cv::Range(0, blocks), [&](const cv::Range& range) {
+        int distance[train_tile];
+        int best[query_block], second[query_block], best_index[query_block];
+        for (int b = range.start; b < range.end; b++)
+        {
+            int begin = b * query_block;
+            int end = std::min(query.rows, begin + query_block);
+            std::fill(best, best + query_block, INT_MAX);
+            std::fill(second, second + query_block, INT_MAX);
+            for (int tile = 0; tile < train.rows; tile += train_tile)
+            {
+                int count = std::min(train_tile, train.rows - tile);
+                for (int i = begin; i < end; i++)
+                {
+                    distances(query.ptr(i), train.ptr(tile), train.step, count, distance);
+                    int k = i - begin;
+                    for (int j = 0; j < count; j++) {
+                        if (distance[j] < best[k]) {
+                            second[k] = best[k];
+                            best[k] = distance[j];
+                            best_index[k] = tile + j;
+                        }
+                        else if (distance[j] < second[k]) {
+                            second[k] = distance[j];
+                        }
+                    }
+                }
+            }
+            for (int i = begin; i < end; i++) {
+                int k = i - begin;
+                if (best[k] < ratio * second[k]) {
+                    found[i] = cv::DMatch(i, best_index[k], (float)best[k]);
+                }
+            }
+        }
+    });
+
+    for (const cv::DMatch& match : found) {
+        if (match.trainIdx >= 0) {
+            matches.push_back(match);
+        }
+    }
+}
+
+} // namespace camerascalib
@@ -0,0 +1,28 @@
+#ifndef CAMERASCALIB_HAMMING_MATCHER_H
+#define CAMERASCALIB_HAMMING_MATCHER_H
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace camerascalib {
+
+// Whether descriptors are 256 bit binary ones (ORB), the only kind
+// HammingRatioMatch takes
+bool HammingMatchable(const cv::Mat& descriptors);
+
+// Brute force ratio test matching of 256 bit binary descriptors, the same
+// matches as cv::BFMatcher with NORM_HAMMING and knnMatch(2) followed by
+// RatioMatch's test, but faster: query rows are split into blocks across
+// threads, each block runs over the train rows tile by tile so a tile stays
+// in cache for all of the block, and distances come from a popcount kernel
+// picked for the CPU at startup (AVX2 or POPCNT on x86, NEON on aarch64).
+void HammingRatioMatch(const cv::Mat& query, const cv::Mat& train,
+    std::vector<cv::DMatch>& matches, float ratio = 0.8f);
+
+// Name of the distance kernel in use
+const char* HammingKernel();
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_HAMMING_MATCHER_H
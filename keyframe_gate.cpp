@@ -0,0 +1,63 @@
+#include "keyframe_gate.h"
+
+#include <algorithm>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace camerascalib {
+
+static const int thumbnail_width = 80;
+
+// Shrink first and convert after, so a colour frame costs a conversion of
+// a few thousand pixels rather than of the whole frame
+static void thumbnail(const Frame& frame, cv::Mat& thumb)
+{
+    cv::Size size = frame.format == PIXEL_FORMAT_NV12 ?
+        cv::Size(frame.image.cols, frame.image.rows * 2 / 3) : frame.image.size();
+    int height = std::max(2, thumbnail_width * size.height / size.width) & ~1;
+
+    Frame small;
+    small.format = frame.format;
+    ScaleFrame(frame, cv::Size(thumbnail_width, height), small.image);
+    ToLuma(small, thumb);
+}
+
+KeyframeGate::KeyframeGate(double threshold)
+    : threshold_(threshold)
+    , accepted_(0)
+    , skipped_(0)
+{
+}
+
+bool KeyframeGate::Accept(const std::vector<Frame>& frames)
+{
+    if (threshold_ <= 0) {
+        accepted_++;
+        return true;
+    }
+
+    thumbnails_.resize(frames.size());
+    bool novel = reference_.size() != frames.size();
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        thumbnail(MatchingBranch(frames[i]), thumbnails_[i]);
+        if (!novel && (reference_[i].size() != thumbnails_[i].size() ||
+            cv::norm(thumbnails_[i], reference_[i], cv::NORM_L1) / thumbnails_[i].total() > threshold_)) {
+            novel = true;
+        }
+    }
+
+    if (!novel) {
+        skipped_++;
+        return false;
+    }
+    reference_.resize(frames.size());
+    for (size_t i = 0; i < frames.size(); i++) {
+        // the thumbnail buffers are reused by the next pair
+        thumbnails_[i].copyTo(reference_[i]);
+    }
+    accepted_++;
+    return true;
+}
+
+} // namespace camerascalib
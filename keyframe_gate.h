@@ -0,0 +1,43 @@
+#ifndef CAMERASCALIB_KEYFRAME_GATE_H
+#define CAMERASCALIB_KEYFRAME_GATE_H
+
+#include <vector>
+#include <atomic>
+
+#include <opencv2/core/core.hpp>
+
+#include "frame.h"
+
+namespace camerascalib {
+
+// Decides which pairs are worth feeding to the calibrator. Each pair is
+// reduced to a tiny luma thumbnail per camera and compared with the last
+// pair let through; only when the scene in some camera has changed by more
+// than threshold (mean absolute difference, in grey levels) is the pair a
+// keyframe. A rig looking at a still scene feeds once instead of every frame,
+// and sensor noise averages out at thumbnail size.
+class KeyframeGate
+{
+public:
+    explicit KeyframeGate(double threshold = 2.0);
+
+    // threshold <= 0 lets every pair through
+    void SetThreshold(double threshold) { threshold_ = threshold; }
+
+    // True if the pair should be fed; it then becomes the reference
+    bool Accept(const std::vector<Frame>& frames);
+
+    uint64_t Accepted() const { return accepted_; }
+    uint64_t Skipped() const { return skipped_; }
+
+private:
+    double threshold_;
+    std::vector<cv::Mat> reference_;
+    std::vector<cv::Mat> thumbnails_;
+    std::atomic<uint64_t> accepted_;
+    std::atomic<uint64_t> skipped_;
+};
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_KEYFRAME_GATE_H
@@ -0,0 +1,166 @@
+#include "latency.h"
+
+#include <iomanip>
+#include <algorithm>
+
+namespace camerascalib {
+
+static const char* stage_names[stage_count] = {
+    "capture", "convert", "upload", "Feed", "Matches", "Evaluate", "download", "imshow", "waitKey"
+};
+
+// Middle of the range of values a bucket holds
+static int64_t bucket_value(int index)
+{
+    if (index < LatencyHistogram::sub_count) {
+        return index;
+    }
+    int shift = index / LatencyHistogram::sub_count - 1;
+    int64_t lower = (int64_t)(LatencyHistogram::sub_count + index % LatencyHistogram::sub_count) << shift;
+    return lower + ((int64_t)1 << shift) / 2;
+}
+
+static void print_ms(std::ostream& out, int64_t ns)
+{
+    out << std::setw(9) << ns / 1e6;
+}
+
+const char* StageName(LatencyStage stage)
+{
+    return stage >= 0 && stage < stage_count ? stage_names[stage] : "unknown";
+}
+
+int64_t LatencyHistogram::Snapshot::Percentile(double q) const
+{
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = std::max<uint64_t>(1, (uint64_t)(q * total + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return bucket_value((int)i);
+        }
+    }
+    return Max();
+}
+
+int64_t LatencyHistogram::Snapshot::Max() const
+{
+    for (size_t i = counts.size(); i > 0; i--) {
+        if (counts[i - 1]) {
+            return bucket_value((int)i - 1);
+        }
+    }
+    return 0;
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::Snapshot::Since(const Snapshot& earlier) const
+{
+    Snapshot interval = *this;
+    if (earlier.counts.size() != counts.size()) {
+        return interval;
+    }
+    for (size_t i = 0; i < counts.size(); i++) {
+        interval.counts[i] -= earlier.counts[i];
+    }
+    interval.total -= earlier.total;
+    interval.sum -= earlier.sum;
+    return interval;
+}
+
+LatencyHistogram::LatencyHistogram()
+    : sum_(0)
+{
+    for (std::atomic<uint64_t>& count : counts_) {
+        count.store(0, std::memory_order_relaxed);
+    }
+}
+
+int LatencyHistogram::Index(int64_t ns)
+{
+    if (ns < sub_count) {
+        return (int)std::max<int64_t>(ns, 0);
+    }
+    int shift = 63 - __builtin_clzll((uint64_t)ns) - sub_bits;
+    if (shift >= octaves) {
+        return bucket_count - 1;
+    }
+    return sub_count * (shift + 1) + (int)((ns >> shift) - sub_count);
+}
+
+void LatencyHistogram::Record(int64_t ns)
+{
+    counts_[Index(ns)].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(ns, std::memory_order_relaxed);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::Take() const
+{
+    // counters read one by one may be a record apart, which no percentile notices
+    Snapshot snapshot;
+    snapshot.counts.resize(bucket_count);
+    for (int i = 0; i < bucket_count; i++) {
+        snapshot.counts[i] = counts_[i].load(std::memory_order_relaxed);
+        snapshot.total += snapshot.counts[i];
+    }
+    snapshot.sum = sum_.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+StageTimers::StageTimers()
+    : last_(stage_count)
+{
+}
+
+void StageTimers::PrintSummary(std::ostream& out)
+{
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(2) << "Latency, ms       p50      p95      p99      max" << std::endl;
+    for (int s = 0; s < stage_count; s++)
+    {
+        LatencyHistogram::Snapshot now = histograms_[s].Take();
+        LatencyHistogram::Snapshot interval = now.Since(last_[s]);
+        last_[s] = now;
+        if (interval.total == 0) {
+            continue;
+        }
+        out << "  " << std::left << std::setw(10) << StageName((LatencyStage)s) << std::right;
+        print_ms(out, interval.Percentile(0.5));
+        print_ms(out, interval.Percentile(0.95));
+        print_ms(out, interval.Percentile(0.99));
+        print_ms(out, interval.Max());
+        out << std::endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void StageTimers::PrintReport(std::ostream& out) const
+{
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(2)
+        << "Latency, ms    count     mean      p50      p95      p99      max" << std::endl;
+    for (int s = 0; s < stage_count; s++)
+    {
+        LatencyHistogram::Snapshot all = histograms_[s].Take();
+        if (all.total == 0) {
+            continue;
+        }
+        out << "  " << std::left << std::setw(10) << StageName((LatencyStage)s) << std::right
+            << std::setw(8) << all.total;
+        print_ms(out, (int64_t)all.Mean());
+        print_ms(out, all.Percentile(0.5));
+        print_ms(out, all.Percentile(0.95));
+        print_ms(out, all.Percentile(0.99));
+        print_ms(out, all.Max());
+        out << std::endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+} // namespace camerascalib
@@ -0,0 +1,115 @@
+#ifndef CAMERASCALIB_LATENCY_H
+#define CAMERASCALIB_LATENCY_H
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+#include "frame.h"
+
+namespace camerascalib {
+
+// Distribution of latencies in the manner of HdrHistogram: buckets exact up
+// to 32 ns, then 32 per power of two, so any value is kept to within about
+// 3% from nanoseconds to a minute in about a thousand counters. Recording
+// is two relaxed atomic additions, so any number of threads record into
+// one histogram without locks; reading takes a snapshot of the counters.
+class LatencyHistogram
+{
+public:
+    static const int sub_bits = 5;
+    static const int sub_count = 1 << sub_bits;
+    static const int octaves = 32;                          // above sub_count ns, up to ~70 s
+    static const int bucket_count = sub_count * (octaves + 1);
+
+    // Counts at one moment, or between two with Since()
+    struct Snapshot
+    {
+        std::vector<uint64_t> counts;
+        uint64_t total = 0;
+        int64_t sum = 0;            // ns
+
+        // Latency at quantile q (0.5 for the median), ns; 0 if empty
+        int64_t Percentile(double q) const;
+        int64_t Max() const;
+        double Mean() const { return total ? (double)sum / total : 0; }
+        Snapshot Since(const Snapshot& earlier) const;
+    };
+
+    LatencyHistogram();
+
+    void Record(int64_t ns);
+    Snapshot Take() const;
+
+private:
+    static int Index(int64_t ns);
+
+    std::atomic<uint64_t> counts_[bucket_count];
+    std::atomic<int64_t> sum_;
+};
+
+// The steps of capture to display that are timed
+enum LatencyStage
+{
+    STAGE_CAPTURE,      // time from a frame's arrival to the pipeline taking its pair
+    STAGE_CONVERT,      // layout conversion for CPU backends
+    STAGE_UPLOAD,       // conversion and upload for GPU backends
+    STAGE_FEED,
+    STAGE_MATCHES,
+    STAGE_EVALUATE,
+    STAGE_DOWNLOAD,     // of the stitched preview
+    STAGE_IMSHOW,
+    STAGE_WAITKEY,
+    stage_count
+};
+
+const char* StageName(LatencyStage stage);
+
+// One histogram per stage, recorded from whichever thread runs the stage
+// and summarised from another
+class StageTimers
+{
+public:
+    StageTimers();
+
+    void Record(LatencyStage stage, int64_t ns) { histograms_[stage].Record(ns); }
+
+    // p50/p95/p99/max per stage over what was recorded since the last
+    // summary. Call from one thread only.
+    void PrintSummary(std::ostream& out);
+    // Count, mean and percentiles per stage over the whole run
+    void PrintReport(std::ostream& out) const;
+
+private:
+    LatencyHistogram histograms_[stage_count];
+    std::vector<LatencyHistogram::Snapshot> last_;
+};
+
+// Times the scope it lives in into a stage; no timers, no timing
+class ScopedLatency
+{
+public:
+    ScopedLatency(StageTimers* timers, LatencyStage stage)
+        : timers_(timers)
+        , stage_(stage)
+        , start_(timers ? MonotonicNs() : 0)
+    {
+    }
+
+    ~ScopedLatency()
+    {
+        if (timers_) {
+            timers_->Record(stage_, MonotonicNs() - start_);
+        }
+    }
+
+private:
+    StageTimers* timers_;
+    LatencyStage stage_;
+    int64_t start_;
+};
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_LATENCY_H
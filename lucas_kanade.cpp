@@ -0,0 +1,276 @@
+#include "lucas_kanade.h"
+
+#include <cmath>
+#include <mutex>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+
+#include <opencv2/core/utility.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "calibrator.h"
+
+namespace camerascalib {
+
+static const size_t min_pixels = 200;   // below that a level is not worth aligning on
+static const size_t chunk = 1024;       // pixels per parallel work item
+
+// What inverse compositional alignment precomputes from the base image at
+// one level: the pixels used, their intensities and steepest descent images
+// (Jacobian times gradient) as structure of arrays, and the inverse Hessian
+struct LevelTemplate
+{
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> value;       // zero mean, unit variance
+    std::vector<float> sd[8];
+    cv::Matx<double, 8, 8> hessian_inverse;
+    cv::Matx33d normalise;          // level pixels to about [-1, 1]
+    size_t Size() const { return x.size(); }
+};
+
+static double dot(const float* a, const float* b, size_t n)
+{
+    double sum = 0;
+    size_t i = 0;
+    // float lanes summed over short runs, the runs in double
+    while (i < n)
+    {
+        size_t end = std::min(n, i + chunk);
+        float partial = 0;
+#if CV_SIMD128
+        cv::v_float32x4 acc = cv::v_setzero_f32();
+        for (; i + 4 <= end; i += 4) {
+            acc = cv::v_muladd(cv::v_load(a + i), cv::v_load(b + i), acc);
+        }
+        partial = cv::v_reduce_sum(acc);
+#endif
+        for (; i < end; i++) {
+            partial += a[i] * b[i];
+        }
+        sum += partial;
+    }
+    return sum;
+}
+
+static bool build_template(const cv::Mat& base, cv::Size image_size, const cv::Matx33d& transform,
+    const RefineSettings& settings, LevelTemplate& level)
+{
+    cv::Mat gx, gy;
+    cv::Sobel(base, gx, CV_32F, 1, 0, 3, 1.0 / 8);
+    cv::Sobel(base, gy, CV_32F, 0, 1, 3, 1.0 / 8);
+
+    // pixels that land well inside the image, so small updates keep them there
+    double border = 2 + 0.02 * std::max(image_size.width, image_size.height);
+    std::vector<cv::Point> candidates;
+    std::vector<float> magnitude;
+    for (int r = 1; r < base.rows - 1; r++)
+    {
+        const float* dx = gx.ptr<float>(r);
+        const float* dy = gy.ptr<float>(r);
+        for (int c = 1; c < base.cols - 1; c++)
+        {
+            cv::Vec3d q = transform * cv::Vec3d(c, r, 1);
+            if (q[2] <= 1e-9) {
+                continue;
+            }
+            double u = q[0] / q[2], v = q[1] / q[2];
+            if (u < border || v < border || u > image_size.width - 1 - border ||
+                v > image_size.height - 1 - border) {
+                continue;
+            }
+            candidates.push_back(cv::Point(c, r));
+            magnitude.push_back(dx[c] * dx[c] + dy[c] * dy[c]);
+        }
+    }
+    if (candidates.size() < min_pixels) {
+        return false;
+    }
+    std::vector<int> order(candidates.size());
+    std::iota(order.begin(), order.end(), 0);
+    if (order.size() > (size_t)settings.max_pixels) {
+        std::nth_element(order.begin(), order.begin() + settings.max_pixels, order.end(),
+            [&](int a, int b) { return magnitude[a] > magnitude[b]; });
+        order.resize(settings.max_pixels);
+    }
+
+    double mean = 0, square = 0;
+    for (int k : order) {
+        double t = base.at<float>(candidates[k]);
+        mean += t;
+        square += t * t;
+    }
+    mean /= order.size();
+    double deviation = std::sqrt(std::max(square / order.size() - mean * mean, 1e-6));
+
+    level.normalise = PixelNormalisation(base.size());
+    const cv::Matx33d& n = level.normalise;
+    double scale = 1 / n(0, 0);     // level pixels per normalised unit
+    level.x.clear();
+    level.y.clear();
+    level.value.clear();
+    for (std::vector<float>& sd : level.sd) {
+        sd.clear();
+    }
+    for (int k : order)
+    {
+        const cv::Point& p = candidates[k];
+        float xn = (float)(n(0, 0) * p.x + n(0, 2));
+        float yn = (float)(n(1, 1) * p.y + n(1, 2));
+        // gradient with respect to normalised coordinates, of the normalised intensities
+        float dx = (float)(gx.at<float>(p) * scale / deviation);
+        float dy = (float)(gy.at<float>(p) * scale / deviation);
+        float g = dx * xn + dy * yn;
+        level.x.push_back((float)p.x);
+        level.y.push_back((float)p.y);
+        level.value.push_back((float)((base.at<float>(p) - mean) / deviation));
+        // d(warp)/d(p) at the identity, dotted with the gradient
+        const float sd[8] = { dx * xn, dx * yn, dx, dy * xn, dy * yn, dy, -xn * g, -yn * g };
+        for (int j = 0; j < 8; j++) {
+            level.sd[j].push_back(sd[j]);
+        }
+    }
+
+    cv::Matx<double, 8, 8> hessian;
+    cv::parallel_for_(cv::Range(0, 64), [&](const cv::Range& range) {
+        for (int e = range.start; e < range.end; e++) {
+            int i = e / 8, j = e % 8;
+            if (j >= i) {
+                hessian(i, j) = dot(level.sd[i].data(), level.sd[j].data(), level.Size());
+            }
+        }
+    });
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < i; j++) {
+            hessian(i, j) = hessian(j, i);
+        }
+    }
+    bool invertible = false;
+    level.hessian_inverse = hessian.inv(cv::DECOMP_CHOLESKY, &invertible);
+    return invertible;
+}
+
+// Normalised differences between image warped by transform and the template
+// into error, zero where a pixel falls outside the image; RMS of those
+// inside, or -1 if fewer than half of them are
+static double residuals(const LevelTemplate& level, const cv::Mat& image,
+    const cv::Matx33d& transform, std::vector<float>& error)
+{
+    const size_t n = level.Size();
+    std::vector<float> warped(n);
+    std::vector<uchar> inside(n);
+    std::mutex lock;
+    double sum = 0, square = 0;
+    size_t count = 0;
+    cv::parallel_for_(cv::Range(0, (int)((n + chunk - 1) / chunk)), [&](const cv::Range& range) {
+        double partial_sum = 0, partial_square = 0;
+        size_t partial_count = 0;
+        for (size_t i = range.start * chunk; i < std::min(n, range.end * chunk); i++)
+        {
+            double w = transform(2, 0) * level.x[i] + transform(2, 1) * level.y[i] + transform(2, 2);
+            double u = (transform(0, 0) * level.x[i] + transform(0, 1) * level.y[i] + transform(0, 2)) / w;
+            double v = (transform(1, 0) * level.x[i] + transform(1, 1) * level.y[i] + transform(1, 2)) / w;
+            inside[i] = w > 0 && u >= 0 && v >= 0 && u < image.cols - 1 && v < image.rows - 1;
+            if (!inside[i]) {
+                continue;
+            }
+            int u0 = (int)u, v0 = (int)v;
+            float a = (float)(u - u0), b = (float)(v - v0);
+            const float* top = image.ptr<float>(v0) + u0;
+            const float* bottom = image.ptr<float>(v0 + 1) + u0;
+            warped[i] = (1 - b) * ((1 - a) * top[0] + a * top[1]) +
+                b * ((1 - a) * bottom[0] + a * bottom[1]);
+            partial_sum += warped[i];
+            partial_square += warped[i] * warped[i];
+            partial_count++;
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        sum += partial_sum;
+        square += partial_square;
+        count += partial_count;
+    });
+    if (count < n / 2 || count < min_pixels) {
+        return -1;
+    }
+
+    // gain and bias of the image taken out like those of the template
+    double mean = sum / count;
+    double deviation = std::sqrt(std::max(square / count - mean * mean, 1e-6));
+    error.resize(n);
+    double total = 0;
+    for (size_t i = 0; i < n; i++) {
+        error[i] = inside[i] ? (float)((warped[i] - mean) / deviation) - level.value[i] : 0.0f;
+        total += error[i] * error[i];
+    }
+    return std::sqrt(total / count);
+}
+
+bool RefineHomography(const cv::Mat& base, const cv::Mat& image, const RefineSettings& settings,
+    cv::Matx33d& transform, double* initial_error, double* final_error)
+{
+    CV_Assert(base.channels() == 1 && image.channels() == 1);
+    cv::Mat base_f, image_f;
+    base.convertTo(base_f, CV_32F);
+    image.convertTo(image_f, CV_32F);
+    std::vector<cv::Mat> base_pyramid, image_pyramid;
+    cv::buildPyramid(base_f, base_pyramid, std::max(0, settings.levels - 1));
+    cv::buildPyramid(image_f, image_pyramid, std::max(0, settings.levels - 1));
+
+    cv::Matx33d refined = transform;
+    LevelTemplate level;
+    std::vector<float> error;
+    for (int l = (int)base_pyramid.size() - 1; l >= 0; l--)
+    {
+        const cv::Mat& template_image = base_pyramid[l];
+        const cv::Mat& level_image = image_pyramid[l];
+        double s = 1.0 / (1 << l);
+        cv::Matx33d scale(s, 0, 0, 0, s, 0, 0, 0, 1);
+        cv::Matx33d current = scale * refined * scale.inv();
+        if (!build_template(template_image, level_image.size(), current, settings, level)) {
+            continue;
+        }
+
+        for (int iteration = 0; iteration < settings.iterations; iteration++)
+        {
+            if (residuals(level, level_image, current, error) < 0) {
+                break;
+            }
+            cv::Vec<double, 8> b;
+            cv::parallel_for_(cv::Range(0, 8), [&](const cv::Range& range) {
+                for (int j = range.start; j < range.end; j++) {
+                    b[j] = dot(level.sd[j].data(), error.data(), level.Size());
+                }
+            });
+            cv::Vec<double, 8> p = level.hessian_inverse * b;
+            cv::Matx33d delta(1 + p[0], p[1], p[2], p[3], 1 + p[4], p[5], p[6], p[7], 1);
+            delta = level.normalise.inv() * delta * level.normalise;
+            current = current * delta.inv();
+            if (HomographyError(delta, cv::Matx33d::eye(), template_image.size()) < settings.epsilon) {
+                break;
+            }
+        }
+        refined = scale.inv() * current * scale;
+    }
+
+    // judged on the full resolution template of the refined transform
+    if (!build_template(base_f, image_f.size(), refined, settings, level)) {
+        return false;
+    }
+    double before = residuals(level, image_f, transform, error);
+    double after = residuals(level, image_f, refined, error);
+    if (initial_error) {
+        *initial_error = before;
+    }
+    if (final_error) {
+        *final_error = after;
+    }
+    if (after < 0 || (before >= 0 && after >= before)) {
+        return false;
+    }
+    transform = refined * (1.0 / refined(2, 2));
+    return true;
+}
+
+} // namespace camerascalib
@@ -0,0 +1,30 @@
+#ifndef CAMERASCALIB_LUCAS_KANADE_H
+#define CAMERASCALIB_LUCAS_KANADE_H
+
+#include <opencv2/core/core.hpp>
+
+namespace camerascalib {
+
+struct RefineSettings
+{
+    int levels = 3;             // pyramid levels, the coarsest at 1/2^(levels-1)
+    int iterations = 20;        // per level, at most
+    int max_pixels = 20000;     // strongest gradient pixels of the overlap used per level
+    double epsilon = 0.01;      // stop a level once an update moves the corners less, pixels
+};
+
+// Refine a homography from base to image coordinates (image(H x) ~ base(x))
+// by direct alignment of intensities, coarse to fine: inverse compositional
+// Lucas-Kanade (Baker and Matthews) on the strongest gradient pixels of the
+// overlap, with gain and bias normalised out, so cameras exposing
+// differently still align. Sampling runs in parallel and the Hessian and
+// gradient sums with SIMD over structure of arrays. Both images are single
+// channel and of the same size. transform is only replaced if the aligned
+// intensities agree better than before; the errors are the RMS of the
+// normalised intensity differences at full resolution.
+bool RefineHomography(const cv::Mat& base, const cv::Mat& image, const RefineSettings& settings,
+    cv::Matx33d& transform, double* initial_error = nullptr, double* final_error = nullptr);
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_LUCAS_KANADE_H
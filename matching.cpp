@@ -0,0 +1,74 @@
+#include "matching.h"
+
+#include <opencv2/imgproc.hpp>
+
+#include "hamming_matcher.h"
+
+namespace camerascalib {
+
+cv::Ptr<cv::Feature2D> CreateDetector(int match_mode, const DetectorSettings& settings)
+{
+    if (match_mode == 1) {
+        cv::Ptr<cv::AKAZE> akaze = cv::AKAZE::create();
+        if (settings.levels > 0) {
+            akaze->setNOctaves(settings.levels);
+        }
+        if (settings.threshold > 0) {
+            akaze->setThreshold(settings.threshold);
+        }
+        return akaze;
+    }
+    if (match_mode == 2) {
+        return cv::BRISK::create(settings.threshold > 0 ? (int)settings.threshold : 30,
+            settings.levels > 0 ? settings.levels : 3);
+    }
+    cv::Ptr<cv::ORB> orb = cv::ORB::create(settings.max_features > 0 ? settings.max_features : 2000);
+    if (settings.levels > 0) {
+        orb->setNLevels(settings.levels);
+    }
+    if (settings.threshold > 0) {
+        orb->setFastThreshold((int)settings.threshold);
+    }
+    return orb;
+}
+
+const char* MatchModeName(int match_mode)
+{
+    static const char* names[match_modes] = { "orb", "akaze", "brisk" };
+    return match_mode >= 0 && match_mode < match_modes ? names[match_mode] : "unknown";
+}
+
+void ToGray(const cv::Mat& image, cv::Mat& gray)
+{
+    if (image.channels() == 1) {
+        gray = image;
+    }
+    else if (image.channels() == 4) {
+        cv::cvtColor(image, gray, cv::COLOR_BGRA2GRAY);
+    }
+    else {
+        cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+    }
+}
+
+void RatioMatch(const cv::DescriptorMatcher& matcher, const cv::Mat& query, const cv::Mat& train,
+    std::vector<cv::DMatch>& matches, float ratio)
+{
+    matches.clear();
+    if (query.empty() || train.empty()) {
+        return;
+    }
+    if (HammingMatchable(query) && HammingMatchable(train)) {
+        HammingRatioMatch(query, train, matches, ratio);
+        return;
+    }
+    std::vector<std::vector<cv::DMatch>> knn;
+    matcher.knnMatch(query, train, knn, 2);
+    for (const std::vector<cv::DMatch>& candidates : knn) {
+        if (candidates.size() == 2 && candidates[0].distance < ratio * candidates[1].distance) {
+            matches.push_back(candidates[0]);
+        }
+    }
+}
+
+} // namespace camerascalib
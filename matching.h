@@ -0,0 +1,39 @@
+#ifndef CAMERASCALIB_MATCHING_H
+#define CAMERASCALIB_MATCHING_H
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d.hpp>
+
+namespace camerascalib {
+
+static const int match_modes = 3;
+
+// Detector parameters shared by the match modes, 0 or less for the mode's default
+struct DetectorSettings
+{
+    int max_features = 2000;    // ORB only, the others keep whatever passes the threshold
+    int levels = 0;             // pyramid levels (ORB) or octaves (AKAZE, BRISK)
+    double threshold = 0;       // FAST threshold (ORB), response (AKAZE), AGAST (BRISK)
+};
+
+// Feature detector and descriptor of a match mode: 0 ORB, 1 AKAZE, 2 BRISK
+cv::Ptr<cv::Feature2D> CreateDetector(int match_mode,
+    const DetectorSettings& settings = DetectorSettings());
+
+// Name of a match mode, "unknown" out of range
+const char* MatchModeName(int match_mode);
+
+// Single channel view or conversion of a gray, BGR or BGRx image
+void ToGray(const cv::Mat& image, cv::Mat& gray);
+
+// Matches of query against train that pass Lowe's ratio test, i.e. whose
+// best candidate is clearly better than the second best. 256 bit binary
+// descriptors go to HammingRatioMatch, anything else to matcher.
+void RatioMatch(const cv::DescriptorMatcher& matcher, const cv::Mat& query, const cv::Mat& train,
+    std::vector<cv::DMatch>& matches, float ratio = 0.8f);
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_MATCHING_H
@@ -0,0 +1,162 @@
+#include "online_estimator.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include "calibrator.h"
+#include "ransac.h"
+
+namespace camerascalib {
+
+static double residual(const cv::Matx33d& transform, const cv::Point2f& p0, const cv::Point2f& p1)
+{
+    cv::Vec3d q = transform * cv::Vec3d(p0.x, p0.y, 1);
+    if (std::abs(q[2]) <= 1e-9) {
+        return HUGE_VAL;
+    }
+    return std::hypot(q[0] / q[2] - p1.x, q[1] / q[2] - p1.y);
+}
+
+OnlineEstimator::OnlineEstimator(const Settings& settings, cv::Size size)
+    : settings_(settings)
+    , size_(size)
+{
+    normalise_ = PixelNormalisation(size);
+    denormalise_ = normalise_.inv();
+    Reset();
+}
+
+void OnlineEstimator::Reset()
+{
+    normal_ = cv::Matx<double, 9, 9>::zeros();
+    transform_ = cv::Matx33d::eye();
+    valid_ = false;
+    converged_ = false;
+    stable_ = 0;
+    change_ = -1;
+    inliers_ = 0;
+    since_refit_ = 0;
+}
+
+bool OnlineEstimator::Accumulate(const cv::Point2f& p0, const cv::Point2f& p1)
+{
+    double r = residual(transform_, p0, p1);
+    if (r > 3 * settings_.threshold) {
+        return false;
+    }
+    // Huber: full weight for inliers, 1/r falloff for the doubtful ones
+    double weight = r <= settings_.threshold ? 1.0 : settings_.threshold / r;
+
+    cv::Vec3d a = normalise_ * cv::Vec3d(p0.x, p0.y, 1);
+    cv::Vec3d b = normalise_ * cv::Vec3d(p1.x, p1.y, 1);
+    double x = a[0], y = a[1], u = b[0], v = b[1];
+    const double rows[2][9] = {
+        { -x, -y, -1, 0, 0, 0, u * x, u * y, u },
+        { 0, 0, 0, -x, -y, -1, v * x, v * y, v }
+    };
+    for (const double* row : rows) {
+        for (int i = 0; i < 9; i++) {
+            for (int j = i; j < 9; j++) {
+                normal_(i, j) += weight * row[i] * row[j];
+            }
+        }
+    }
+    return true;
+}
+
+bool OnlineEstimator::Solve()
+{
+    // only the upper triangle is accumulated
+    cv::Matx<double, 9, 9> normal = normal_;
+    for (int i = 0; i < 9; i++) {
+        for (int j = 0; j < i; j++) {
+            normal(i, j) = normal(j, i);
+        }
+    }
+    cv::Mat eigenvalues, eigenvectors;
+    if (!cv::eigen(cv::Mat(normal), eigenvalues, eigenvectors)) {
+        return false;
+    }
+    // the solution is the eigenvector of the smallest eigenvalue, the last row
+    cv::Matx33d solution;
+    for (int i = 0; i < 9; i++) {
+        solution(i / 3, i % 3) = eigenvectors.at<double>(8, i);
+    }
+    cv::Matx33d transform = denormalise_ * solution * normalise_;
+    if (std::abs(transform(2, 2)) <= 1e-12) {
+        return false;
+    }
+    transform_ = transform * (1.0 / transform(2, 2));
+    return true;
+}
+
+void OnlineEstimator::Refit(const Correspondences& points)
+{
+    RansacSettings ransac;
+    ransac.threshold = settings_.threshold;
+    std::vector<uchar> mask;
+    cv::Matx33d transform;
+    if (!FindHomographyRansac(points, ransac, transform, &mask)) {
+        return;
+    }
+    transform_ = transform;
+    // reweight a few times from the RANSAC solution
+    for (int pass = 0; pass < 3; pass++)
+    {
+        normal_ = cv::Matx<double, 9, 9>::zeros();
+        inliers_ = 0;
+        for (size_t i = 0; i < points.Size(); i++) {
+            if (mask[i] && Accumulate(points.Point0(i), points.Point1(i))) {
+                inliers_++;
+            }
+        }
+        if (inliers_ < 4 || !Solve()) {
+            break;
+        }
+    }
+    since_refit_ = 0;
+    valid_ = true;
+}
+
+void OnlineEstimator::Settle(const cv::Matx33d& previous, bool had_estimate)
+{
+    if (!had_estimate) {
+        return;
+    }
+    change_ = HomographyError(transform_, previous, size_);
+    stable_ = change_ < settings_.tolerance ? stable_ + 1 : 0;
+    converged_ = stable_ >= settings_.stable_updates;
+}
+
+bool OnlineEstimator::Update(const Correspondences& points, const Correspondences& added)
+{
+    if (points.Size() < settings_.min_points) {
+        return false;
+    }
+
+    cv::Matx33d previous = transform_;
+    bool had_estimate = valid_;
+    since_refit_ += added.Size();
+    if (!valid_ || since_refit_ >= settings_.refit_interval) {
+        Refit(points);
+        if (!valid_) {
+            return false;
+        }
+    }
+    else {
+        size_t accepted = 0;
+        for (size_t i = 0; i < added.Size(); i++) {
+            if (Accumulate(added.Point0(i), added.Point1(i))) {
+                accepted++;
+            }
+        }
+        if (accepted == 0 || !Solve()) {
+            return false;
+        }
+        inliers_ += accepted;
+    }
+    Settle(previous, had_estimate);
+    return true;
+}
+
+} // namespace camerascalib
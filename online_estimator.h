@@ -0,0 +1,74 @@
+#ifndef CAMERASCALIB_ONLINE_ESTIMATOR_H
+#define CAMERASCALIB_ONLINE_ESTIMATOR_H
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "correspondences.h"
+
+namespace camerascalib {
+
+// Keeps a homography estimate up to date as correspondences stream in.
+// New correspondences are weighted by their residual under the current
+// estimate (Huber, gross outliers get no weight) and added to the normal
+// equations of a normalised DLT, which are solved after every batch. Every
+// refit_interval correspondences, and for the first estimate, a RANSAC fit
+// over everything collected so far rebuilds the equations from its inliers
+// with a few reweighting passes, so early mistakes do not stick.
+//
+// The corner shift between consecutive estimates is the convergence metric;
+// once it stays under tolerance for stable_updates batches the estimate is
+// considered converged.
+class OnlineEstimator
+{
+public:
+    struct Settings
+    {
+        double tolerance = 0.5;         // pixels of corner shift per update
+        int stable_updates = 3;
+        size_t min_points = 50;         // before the first estimate
+        size_t refit_interval = 1000;   // correspondences between robust refits
+        double threshold = 3.0;         // inlier residual, pixels
+    };
+
+    OnlineEstimator(const Settings& settings, cv::Size size);
+
+    // Take in the correspondences added since the last update; points, all
+    // of those currently kept, is what the robust refits run on. True if
+    // the estimate changed.
+    bool Update(const Correspondences& points, const Correspondences& added);
+
+    void Reset();
+
+    bool Valid() const { return valid_; }
+    bool Converged() const { return converged_; }
+    // Corner shift of the last update, in pixels, negative before the second estimate
+    double Change() const { return change_; }
+    size_t Inliers() const { return inliers_; }
+    const cv::Matx33d& Transform() const { return transform_; }
+
+private:
+    void Refit(const Correspondences& points);
+    // Add a correspondence to the normal equations; false if it is an outlier
+    bool Accumulate(const cv::Point2f& p0, const cv::Point2f& p1);
+    bool Solve();
+    void Settle(const cv::Matx33d& previous, bool had_estimate);
+
+    Settings settings_;
+    cv::Size size_;
+    cv::Matx33d normalise_;         // pixels to roughly [-1, 1], both cameras
+    cv::Matx33d denormalise_;
+    cv::Matx<double, 9, 9> normal_;
+    cv::Matx33d transform_;
+    bool valid_;
+    bool converged_;
+    int stable_;
+    double change_;
+    size_t inliers_;
+    size_t since_refit_;            // correspondences taken in since the last refit
+};
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_ONLINE_ESTIMATOR_H
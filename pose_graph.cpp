@@ -0,0 +1,203 @@
+#include "pose_graph.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include <opencv2/core/utility.hpp>
+
+#include "calibrator.h"
+
+namespace camerascalib {
+
+static cv::Matx33d normalised(const cv::Matx33d& transform)
+{
+    return transform * (1.0 / transform(2, 2));
+}
+
+PoseGraph::PoseGraph(int cameras, cv::Size size)
+    : cameras_(cameras)
+    , transforms_(cameras, cv::Matx33d::eye())
+    , connected_(cameras, false)
+{
+    normalise_ = PixelNormalisation(size);
+    denormalise_ = normalise_.inv();
+}
+
+void PoseGraph::AddEdge(const PoseEdge& edge)
+{
+    edges_.push_back(edge);
+}
+
+bool PoseGraph::Initialise()
+{
+    connected_.assign(cameras_, false);
+    transforms_.assign(cameras_, cv::Matx33d::eye());
+    connected_[0] = true;
+
+    for (;;)
+    {
+        // the strongest edge leaving the tree
+        const PoseEdge* best = nullptr;
+        for (const PoseEdge& edge : edges_) {
+            if (connected_[edge.from] != connected_[edge.to] &&
+                (!best || edge.points_from.size() > best->points_from.size())) {
+                best = &edge;
+            }
+        }
+        if (!best) {
+            break;
+        }
+        if (connected_[best->from]) {
+            transforms_[best->to] = normalised(best->transform * transforms_[best->from]);
+            connected_[best->to] = true;
+        }
+        else {
+            transforms_[best->from] = normalised(best->transform.inv() * transforms_[best->to]);
+            connected_[best->from] = true;
+        }
+    }
+
+    free_.clear();
+    for (int c = 1; c < cameras_; c++) {
+        if (connected_[c]) {
+            free_.push_back(c);
+        }
+    }
+    return std::find(connected_.begin(), connected_.end(), false) == connected_.end();
+}
+
+void PoseGraph::Residuals(const std::vector<cv::Matx33d>& transforms, cv::Mat& residuals) const
+{
+    size_t count = 0;
+    for (const PoseEdge& edge : edges_) {
+        if (connected_[edge.from] && connected_[edge.to]) {
+            count += edge.points_from.size();
+        }
+    }
+    residuals.create((int)count * 2, 1, CV_64F);
+
+    double* r = residuals.ptr<double>();
+    for (const PoseEdge& edge : edges_)
+    {
+        if (!connected_[edge.from] || !connected_[edge.to]) {
+            continue;
+        }
+        // what the rig says this edge should measure
+        cv::Matx33d transfer = transforms[edge.to] * transforms[edge.from].inv();
+        for (size_t k = 0; k < edge.points_from.size(); k++)
+        {
+            const cv::Point2f& a = edge.points_from[k];
+            const cv::Point2f& b = edge.points_to[k];
+            cv::Vec3d q = transfer * cv::Vec3d(a.x, a.y, 1);
+            double w = std::abs(q[2]) > 1e-12 ? q[2] : 1e-12;
+            *r++ = q[0] / w - b.x;
+            *r++ = q[1] / w - b.y;
+        }
+    }
+}
+
+void PoseGraph::ToParameters(const std::vector<cv::Matx33d>& transforms, cv::Mat& parameters) const
+{
+    parameters.create((int)free_.size() * 8, 1, CV_64F);
+    double* p = parameters.ptr<double>();
+    for (int camera : free_)
+    {
+        cv::Matx33d h = normalised(normalise_ * transforms[camera] * denormalise_);
+        for (int i = 0; i < 8; i++) {
+            *p++ = h(i / 3, i % 3);
+        }
+    }
+}
+
+void PoseGraph::FromParameters(const cv::Mat& parameters, std::vector<cv::Matx33d>& transforms) const
+{
+    transforms = transforms_;
+    const double* p = parameters.ptr<double>();
+    for (int camera : free_)
+    {
+        cv::Matx33d h;
+        for (int i = 0; i < 8; i++) {
+            h(i / 3, i % 3) = *p++;
+        }
+        h(2, 2) = 1;
+        transforms[camera] = normalised(denormalise_ * h * normalise_);
+    }
+}
+
+void PoseGraph::Refine(int iterations, double& initial_rms, double& final_rms)
+{
+    cv::Mat parameters, residuals;
+    ToParameters(transforms_, parameters);
+    Residuals(transforms_, residuals);
+    double cost = residuals.dot(residuals);
+    int points = std::max(residuals.rows / 2, 1);
+    initial_rms = final_rms = std::sqrt(cost / points);
+    if (free_.empty() || residuals.rows == 0) {
+        return;
+    }
+
+    const double step = 1e-7;
+    const int n = parameters.rows;
+    const int m = residuals.rows;
+    cv::Mat jacobian(m, n, CV_64F);
+    double lambda = 1e-3;
+    for (int iteration = 0; iteration < iterations; iteration++)
+    {
+        // forward differences, one column per parameter, all in parallel
+        cv::parallel_for_(cv::Range(0, n), [&](const cv::Range& range) {
+            std::vector<cv::Matx33d> transforms;
+            cv::Mat shifted, shifted_residuals;
+            for (int j = range.start; j < range.end; j++)
+            {
+                parameters.copyTo(shifted);
+                shifted.at<double>(j) += step;
+                FromParameters(shifted, transforms);
+                Residuals(transforms, shifted_residuals);
+                for (int i = 0; i < m; i++) {
+                    jacobian.at<double>(i, j) =
+                        (shifted_residuals.at<double>(i) - residuals.at<double>(i)) / step;
+                }
+            }
+        });
+
+        cv::Mat normal, gradient;
+        cv::mulTransposed(jacobian, normal, true);
+        cv::gemm(jacobian, residuals, -1, cv::noArray(), 0, gradient, cv::GEMM_1_T);
+
+        bool improved = false;
+        while (lambda < 1e10)
+        {
+            cv::Mat damped = normal.clone();
+            for (int i = 0; i < n; i++) {
+                damped.at<double>(i, i) *= 1 + lambda;
+            }
+            cv::Mat delta;
+            if (cv::solve(damped, gradient, delta, cv::DECOMP_CHOLESKY))
+            {
+                cv::Mat candidate = parameters + delta;
+                std::vector<cv::Matx33d> transforms;
+                cv::Mat candidate_residuals;
+                FromParameters(candidate, transforms);
+                Residuals(transforms, candidate_residuals);
+                double candidate_cost = candidate_residuals.dot(candidate_residuals);
+                if (candidate_cost < cost)
+                {
+                    improved = cost - candidate_cost > 1e-10 * cost;
+                    parameters = candidate;
+                    residuals = candidate_residuals;
+                    transforms_ = transforms;
+                    cost = candidate_cost;
+                    lambda = std::max(lambda / 10, 1e-12);
+                    break;
+                }
+            }
+            lambda *= 10;
+        }
+        if (!improved) {
+            break;
+        }
+    }
+    final_rms = std::sqrt(cost / points);
+}
+
+} // namespace camerascalib
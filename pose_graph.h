@@ -0,0 +1,64 @@
+#ifndef CAMERASCALIB_POSE_GRAPH_H
+#define CAMERASCALIB_POSE_GRAPH_H
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace camerascalib {
+
+// A measured transform between two cameras of the rig and the inlier
+// correspondences it was estimated from
+struct PoseEdge
+{
+    int from = 0;
+    int to = 0;
+    cv::Matx33d transform;              // from camera coordinates to camera coordinates
+    std::vector<cv::Point2f> points_from;
+    std::vector<cv::Point2f> points_to;
+};
+
+// The cameras of a rig as nodes and their pairwise transforms as edges.
+// Every camera's transform is expressed from camera 0. Pairwise estimates
+// on their own do not agree around loops (0->1->2 differs from 0->2), so
+// after chaining the strongest edges into a first estimate the transforms of
+// all cameras are refined together, bundle adjustment style, minimising the
+// transfer error of every edge's inliers.
+class PoseGraph
+{
+public:
+    PoseGraph(int cameras, cv::Size size);
+
+    void AddEdge(const PoseEdge& edge);
+
+    // Chain the edges with the most inliers out from camera 0 (a maximum
+    // spanning tree). False if some camera cannot be reached.
+    bool Initialise();
+
+    // Levenberg-Marquardt over the transforms of every reached camera but
+    // camera 0. Returns the RMS transfer error, in pixels, before and after.
+    void Refine(int iterations, double& initial_rms, double& final_rms);
+
+    int Cameras() const { return cameras_; }
+    const std::vector<PoseEdge>& Edges() const { return edges_; }
+    bool Connected(int camera) const { return connected_[camera]; }
+    // Camera 0 to camera coordinates
+    const cv::Matx33d& Transform(int camera) const { return transforms_[camera]; }
+
+private:
+    void Residuals(const std::vector<cv::Matx33d>& transforms, cv::Mat& residuals) const;
+    void ToParameters(const std::vector<cv::Matx33d>& transforms, cv::Mat& parameters) const;
+    void FromParameters(const cv::Mat& parameters, std::vector<cv::Matx33d>& transforms) const;
+
+    int cameras_;
+    cv::Matx33d normalise_;         // pixels to roughly [-1, 1], so parameters are comparable
+    cv::Matx33d denormalise_;
+    std::vector<PoseEdge> edges_;
+    std::vector<cv::Matx33d> transforms_;
+    std::vector<bool> connected_;
+    std::vector<int> free_;         // cameras whose transform is refined
+};
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_POSE_GRAPH_H
@@ -0,0 +1,266 @@
+#include "ransac.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include <opencv2/core/utility.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/calib3d.hpp>
+
+namespace camerascalib {
+
+static const int batch_size = 64;      // hypotheses scored in parallel per round
+static const size_t block_size = 256;  // points scored between two SPRT decisions
+
+// Points of [begin, end) that h (row major, float) maps to within sqrt(t2).
+// The test is done without division, |H p0 - w p1|^2 <= t2 w^2, so a lane
+// costs a handful of multiply-adds.
+static size_t score_range(const Correspondences& points, const float* h, float t2,
+    size_t begin, size_t end)
+{
+    size_t i = begin;
+    size_t count = 0;
+#if CV_SIMD128
+    cv::v_float32x4 h0 = cv::v_setall_f32(h[0]), h1 = cv::v_setall_f32(h[1]),
+        h2 = cv::v_setall_f32(h[2]), h3 = cv::v_setall_f32(h[3]),
+        h4 = cv::v_setall_f32(h[4]), h5 = cv::v_setall_f32(h[5]),
+        h6 = cv::v_setall_f32(h[6]), h7 = cv::v_setall_f32(h[7]),
+        h8 = cv::v_setall_f32(h[8]), threshold = cv::v_setall_f32(t2);
+    cv::v_int32x4 counts = cv::v_setzero_s32();
+    for (; i + 4 <= end; i += 4)
+    {
+        cv::v_float32x4 x = cv::v_load(&points.x0[i]);
+        cv::v_float32x4 y = cv::v_load(&points.y0[i]);
+        cv::v_float32x4 u = cv::v_load(&points.x1[i]);
+        cv::v_float32x4 v = cv::v_load(&points.y1[i]);
+        cv::v_float32x4 w = cv::v_muladd(h6, x, cv::v_muladd(h7, y, h8));
+        cv::v_float32x4 dx = cv::v_muladd(h0, x, cv::v_muladd(h1, y, h2)) - u * w;
+        cv::v_float32x4 dy = cv::v_muladd(h3, x, cv::v_muladd(h4, y, h5)) - v * w;
+        cv::v_float32x4 error = cv::v_muladd(dx, dx, dy * dy);
+        // true lanes are all ones, i.e. -1
+        counts -= cv::v_reinterpret_as_s32(error <= threshold * w * w);
+    }
+    count = (size_t)cv::v_reduce_sum(counts);
+#endif
+    for (; i < end; i++)
+    {
+        float w = h[6] * points.x0[i] + h[7] * points.y0[i] + h[8];
+        float dx = h[0] * points.x0[i] + h[1] * points.y0[i] + h[2] - points.x1[i] * w;
+        float dy = h[3] * points.x0[i] + h[4] * points.y0[i] + h[5] - points.y1[i] * w;
+        if (dx * dx + dy * dy <= t2 * w * w) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static void to_float(const cv::Matx33d& transform, float h[9])
+{
+    for (int i = 0; i < 9; i++) {
+        h[i] = (float)transform(i / 3, i % 3);
+    }
+}
+
+static bool collinear(const cv::Point2f& a, const cv::Point2f& b, const cv::Point2f& c)
+{
+    return std::abs((b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x)) < 1.0f;
+}
+
+// Homography through four random correspondences, false for degenerate samples
+static bool fit_sample(const Correspondences& points, cv::RNG& rng, cv::Matx33d& transform)
+{
+    size_t index[4];
+    cv::Point2f src[4], dst[4];
+    for (int k = 0; k < 4; k++)
+    {
+        bool repeated;
+        do {
+            index[k] = (size_t)rng.uniform(0, (int)points.Size());
+            repeated = std::find(index, index + k, index[k]) != index + k;
+        } while (repeated);
+        src[k] = points.Point0(index[k]);
+        dst[k] = points.Point1(index[k]);
+    }
+    for (int k = 0; k < 4; k++) {
+        int a = (k + 1) % 4, b = (k + 2) % 4;
+        if (collinear(src[k], src[a], src[b]) || collinear(dst[k], dst[a], dst[b])) {
+            return false;
+        }
+    }
+    cv::Mat h = cv::getPerspectiveTransform(src, dst);
+    if (h.empty() || !std::isfinite(h.at<double>(2, 2)) || std::abs(h.at<double>(2, 2)) < 1e-12) {
+        return false;
+    }
+    transform = cv::Matx33d(h);
+    return true;
+}
+
+// Decision threshold of the SPRT, log A, for the current estimates of the
+// inlier ratio of a good model (epsilon) and of a bad one (delta)
+static double sprt_log_threshold(double epsilon, double delta)
+{
+    // a hypothesis costs about this many point evaluations to sample and fit
+    const double fit_cost = 200;
+    double c = (1 - delta) * std::log((1 - delta) / (1 - epsilon)) +
+        delta * std::log(delta / epsilon);
+    double a0 = fit_cost * c + 1;
+    double a = a0;
+    for (int i = 0; i < 10; i++) {
+        a = a0 + std::log(a);
+    }
+    return std::log(a);
+}
+
+static int iterations_for(double inlier_ratio, double confidence, int max_iterations)
+{
+    double p = std::pow(inlier_ratio, 4);
+    if (p <= 1e-12) {
+        return max_iterations;
+    }
+    if (p >= 1 - 1e-12) {
+        return 1;
+    }
+    double k = std::log(1 - confidence) / std::log(1 - p);
+    return (int)std::min<double>(max_iterations, std::ceil(k));
+}
+
+size_t CountInliers(const Correspondences& points, const cv::Matx33d& transform,
+    double threshold)
+{
+    float h[9];
+    to_float(transform, h);
+    return score_range(points, h, (float)(threshold * threshold), 0, points.Size());
+}
+
+bool FindHomographyRansac(const Correspondences& points, const RansacSettings& settings,
+    cv::Matx33d& transform, std::vector<uchar>* inliers)
+{
+    const size_t n = points.Size();
+    if (n < 4) {
+        return false;
+    }
+    const float t2 = (float)(settings.threshold * settings.threshold);
+
+    struct Hypothesis
+    {
+        cv::Matx33d transform;
+        size_t consistent;
+        size_t tested;
+        bool valid;
+        bool rejected;
+    };
+    std::vector<Hypothesis> hypotheses(batch_size);
+
+    double epsilon = 0.2;   // inlier ratio of a good model, refined from the best so far
+    double delta = 0.02;    // consistency of a bad model, refined from the rejected ones
+    double rejected_consistency = 0;
+    size_t rejected = 0;
+    size_t best_inliers = 0;
+    cv::Matx33d best;
+    int bound = settings.max_iterations;
+    for (int done = 0; done < bound; done += batch_size)
+    {
+        double log_threshold = sprt_log_threshold(epsilon, delta);
+        double log_consistent = std::log(delta / epsilon);
+        double log_inconsistent = std::log((1 - delta) / (1 - epsilon));
+
+        cv::parallel_for_(cv::Range(0, batch_size), [&](const cv::Range& range) {
+            for (int k = range.start; k < range.end; k++)
+            {
+                Hypothesis& hypothesis = hypotheses[k];
+                hypothesis.consistent = 0;
+                hypothesis.tested = 0;
+                hypothesis.rejected = false;
+                cv::RNG rng((uint64_t)(done + k + 1) * 0x9E3779B97F4A7C15ULL);
+                hypothesis.valid = fit_sample(points, rng, hypothesis.transform);
+                if (!hypothesis.valid) {
+                    continue;
+                }
+
+                float h[9];
+                to_float(hypothesis.transform, h);
+                double log_lambda = 0;
+                for (size_t begin = 0; begin < n; begin += block_size)
+                {
+                    size_t end = std::min(n, begin + block_size);
+                    size_t consistent = score_range(points, h, t2, begin, end);
+                    hypothesis.consistent += consistent;
+                    hypothesis.tested = end;
+                    if (!settings.sprt) {
+                        continue;
+                    }
+                    log_lambda += consistent * log_consistent +
+                        (end - begin - consistent) * log_inconsistent;
+                    if (log_lambda > log_threshold) {
+                        hypothesis.rejected = true;
+                        break;
+                    }
+                }
+            }
+        });
+
+        bool improved = false;
+        for (const Hypothesis& hypothesis : hypotheses)
+        {
+            if (!hypothesis.valid) {
+                continue;
+            }
+            if (hypothesis.rejected) {
+                rejected_consistency += (double)hypothesis.consistent / hypothesis.tested;
+                rejected++;
+            }
+            else if (hypothesis.consistent > best_inliers) {
+                best_inliers = hypothesis.consistent;
+                best = hypothesis.transform;
+                improved = true;
+            }
+        }
+
+        if (improved) {
+            epsilon = std::min(0.99, std::max(0.01, (double)best_inliers / n));
+            bound = iterations_for(epsilon, settings.confidence, settings.max_iterations);
+        }
+        else if (best_inliers == 0) {
+            // everything was rejected, the guess of a good model was too optimistic
+            epsilon = std::max(0.01, epsilon / 2);
+        }
+        if (rejected > 0) {
+            delta = rejected_consistency / rejected;
+        }
+        delta = std::min(std::max(delta, 1e-4), epsilon / 2);
+    }
+    if (best_inliers < 4) {
+        return false;
+    }
+
+    // least squares on the inliers of the best hypothesis
+    float h[9];
+    to_float(best, h);
+    std::vector<cv::Point2f> src, dst;
+    src.reserve(best_inliers);
+    dst.reserve(best_inliers);
+    for (size_t i = 0; i < n; i++) {
+        if (score_range(points, h, t2, i, i + 1)) {
+            src.push_back(points.Point0(i));
+            dst.push_back(points.Point1(i));
+        }
+    }
+    cv::Mat refined = cv::findHomography(src, dst, 0);
+    if (!refined.empty() &&
+        CountInliers(points, cv::Matx33d(refined), settings.threshold) >= best_inliers) {
+        best = cv::Matx33d(refined);
+    }
+    transform = best * (1.0 / best(2, 2));
+
+    if (inliers) {
+        to_float(transform, h);
+        inliers->resize(n);
+        for (size_t i = 0; i < n; i++) {
+            (*inliers)[i] = score_range(points, h, t2, i, i + 1) ? 1 : 0;
+        }
+    }
+    return true;
+}
+
+} // namespace camerascalib
@@ -0,0 +1,37 @@
+#ifndef CAMERASCALIB_RANSAC_H
+#define CAMERASCALIB_RANSAC_H
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "correspondences.h"
+
+namespace camerascalib {
+
+struct RansacSettings
+{
+    double threshold = 3.0;     // inlier transfer error, pixels
+    double confidence = 0.995;
+    int max_iterations = 2000;
+    bool sprt = true;           // reject hopeless hypotheses early
+};
+
+// Robust homography from camera 0 to camera 1 points, for large sets.
+// Hypotheses from random four-point samples are generated and scored in
+// parallel batches; scoring runs on the structure of arrays with SIMD and,
+// with sprt set, is a sequential probability ratio test (Matas and Chum,
+// "Randomized RANSAC with Sequential Probability Ratio Test"), so a bad
+// hypothesis is usually given up on after a few hundred points rather than
+// after all of them. The best hypothesis is refitted by least squares on
+// its inliers. Results are repeatable: sampling is seeded by hypothesis.
+bool FindHomographyRansac(const Correspondences& points, const RansacSettings& settings,
+    cv::Matx33d& transform, std::vector<uchar>* inliers = nullptr);
+
+// Number of points that transform maps to within threshold, SIMD
+size_t CountInliers(const Correspondences& points, const cv::Matx33d& transform,
+    double threshold);
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_RANSAC_H
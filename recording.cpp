@@ -0,0 +1,305 @@
+#include "recording.h"
+
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace camerascalib {
+
+static uint64_t align_up(uint64_t value)
+{
+    return (value + record_alignment - 1) / record_alignment * record_alignment;
+}
+
+RecordWriter::RecordWriter(size_t queue_size)
+    : file_(nullptr)
+    , cameras_(0)
+    , offset_(0)
+    , queue_size_(queue_size)
+    , closing_(false)
+    , failed_(false)
+    , written_(0)
+    , dropped_(0)
+{
+}
+
+RecordWriter::~RecordWriter()
+{
+    Close();
+}
+
+bool RecordWriter::Open(const std::string& path, int cameras)
+{
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_) {
+        return false;
+    }
+    cameras_ = cameras;
+
+    RecordFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, record_magic, sizeof(header.magic));
+    header.version = 1;
+    header.cameras = cameras_;
+    if (std::fwrite(&header, sizeof(header), 1, file_) != 1) {
+        std::fclose(file_);
+        file_ = nullptr;
+        return false;
+    }
+    offset_ = sizeof(header);
+
+    closing_ = false;
+    failed_ = false;
+    thread_ = std::thread(&RecordWriter::Run, this);
+    return true;
+}
+
+void RecordWriter::Close()
+{
+    if (!file_) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closing_ = true;
+    }
+    cond_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    // index at the end, then point the file header at it
+    RecordFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, record_magic, sizeof(header.magic));
+    header.version = 1;
+    header.cameras = cameras_;
+    header.index_offset = offset_;
+    header.entries = index_.size();
+    if (!index_.empty()) {
+        std::fwrite(index_.data(), sizeof(uint64_t), index_.size(), file_);
+    }
+    std::fseek(file_, 0, SEEK_SET);
+    std::fwrite(&header, sizeof(header), 1, file_);
+    std::fclose(file_);
+    file_ = nullptr;
+}
+
+bool RecordWriter::Append(const std::vector<Frame>& frames)
+{
+    if (frames.size() != cameras_) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closing_ || failed_ || queue_.size() >= queue_size_) {
+            ++dropped_;
+            return false;
+        }
+        queue_.push_back(frames);
+    }
+    cond_.notify_one();
+    return true;
+}
+
+void RecordWriter::Run()
+{
+    for (;;)
+    {
+        std::vector<Frame> frames;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this] { return closing_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return;
+            }
+            frames.swap(queue_.front());
+            queue_.pop_front();
+        }
+        if (failed_) {
+            ++dropped_;
+        }
+        else if (!Write(frames)) {
+            std::cerr << "Failed to write recording, no longer recording!" << std::endl;
+            // back to the end of the last complete entry, where Close puts the index
+            std::clearerr(file_);
+            ::fseeko(file_, (off_t)offset_, SEEK_SET);
+            failed_ = true;
+            ++dropped_;
+        }
+    }
+}
+
+bool RecordWriter::Write(const std::vector<Frame>& frames)
+{
+    static const uint8_t padding[record_alignment] = { 0 };
+
+    RecordEntryHeader entry;
+    std::memset(&entry, 0, sizeof(entry));
+    entry.magic = record_entry_magic;
+    entry.cameras = cameras_;
+    entry.sequence = index_.size();
+
+    std::vector<RecordImageHeader> images(cameras_);
+    uint64_t size = align_up(sizeof(entry) + sizeof(RecordImageHeader) * cameras_);
+    for (uint32_t i = 0; i < cameras_; i++)
+    {
+        const cv::Mat& image = frames[i].image;
+        RecordImageHeader& header = images[i];
+        std::memset(&header, 0, sizeof(header));
+        header.timestamp = frames[i].timestamp;
+        header.sequence = frames[i].sequence;
+        header.format = frames[i].format;
+        header.type = image.type();
+        header.cols = image.cols;
+        header.rows = image.rows;
+        header.stride = image.cols * image.elemSize();
+        header.offset = size;
+        size = align_up(size + header.stride * header.rows);
+    }
+    entry.size = size;
+
+    // entries and images are aligned, rows are written packed
+    uint64_t written = sizeof(entry) + sizeof(RecordImageHeader) * cameras_;
+    if (std::fwrite(&entry, sizeof(entry), 1, file_) != 1 ||
+        std::fwrite(images.data(), sizeof(RecordImageHeader), cameras_, file_) != cameras_) {
+        return false;
+    }
+    for (uint32_t i = 0; i < cameras_; i++)
+    {
+        const cv::Mat& image = frames[i].image;
+        std::fwrite(padding, 1, images[i].offset - written, file_);
+        if (image.isContinuous()) {
+            std::fwrite(image.data, 1, images[i].stride * images[i].rows, file_);
+        }
+        else {
+            for (int y = 0; y < image.rows; y++) {
+                std::fwrite(image.ptr(y), 1, images[i].stride, file_);
+            }
+        }
+        written = images[i].offset + images[i].stride * images[i].rows;
+    }
+    std::fwrite(padding, 1, size - written, file_);
+    if (std::ferror(file_)) {
+        return false;
+    }
+
+    index_.push_back(offset_);
+    offset_ += size;
+    ++written_;
+    return true;
+}
+
+RecordReader::RecordReader()
+    : data_(nullptr)
+    , size_(0)
+    , cameras_(0)
+{
+}
+
+RecordReader::~RecordReader()
+{
+    Close();
+}
+
+bool RecordReader::Open(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(RecordFileHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void* data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    data_ = static_cast<const uint8_t*>(data);
+    size_ = st.st_size;
+    // replay reads front to back
+    ::madvise(data, size_, MADV_SEQUENTIAL);
+
+    const RecordFileHeader* header = reinterpret_cast<const RecordFileHeader*>(data_);
+    if (std::memcmp(header->magic, record_magic, sizeof(header->magic)) != 0 ||
+        header->version != 1) {
+        Close();
+        return false;
+    }
+    cameras_ = header->cameras;
+
+    entries_.clear();
+    if (header->index_offset != 0 &&
+        header->index_offset + header->entries * sizeof(uint64_t) <= size_) {
+        const uint64_t* index = reinterpret_cast<const uint64_t*>(data_ + header->index_offset);
+        entries_.assign(index, index + header->entries);
+    }
+    else {
+        // recording was not closed, walk the entries
+        uint64_t offset = sizeof(RecordFileHeader);
+        while (offset + sizeof(RecordEntryHeader) <= size_)
+        {
+            const RecordEntryHeader* entry =
+                reinterpret_cast<const RecordEntryHeader*>(data_ + offset);
+            if (entry->magic != record_entry_magic || entry->size == 0 ||
+                offset + entry->size > size_) {
+                break;
+            }
+            entries_.push_back(offset);
+            offset += entry->size;
+        }
+    }
+    return true;
+}
+
+void RecordReader::Close()
+{
+    if (data_) {
+        ::munmap(const_cast<uint8_t*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    entries_.clear();
+}
+
+bool RecordReader::Read(size_t entry, int camera, Frame& frame) const
+{
+    if (entry >= entries_.size() || camera < 0 || camera >= cameras_) {
+        return false;
+    }
+    const uint8_t* base = data_ + entries_[entry];
+    const RecordImageHeader* header = reinterpret_cast<const RecordImageHeader*>(
+        base + sizeof(RecordEntryHeader)) + camera;
+    if (entries_[entry] + header->offset + header->stride * header->rows > size_) {
+        return false;
+    }
+
+    frame.image = cv::Mat(header->rows, header->cols, header->type,
+        const_cast<uint8_t*>(base + header->offset), header->stride);
+    frame.timestamp = header->timestamp;
+    frame.sequence = header->sequence;
+    frame.format = static_cast<PixelFormat>(header->format);
+    return true;
+}
+
+bool RecordReader::IsRecording(const std::string& path)
+{
+    char magic[sizeof(record_magic)];
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    bool match = std::fread(magic, sizeof(magic), 1, file) == 1 &&
+        std::memcmp(magic, record_magic, sizeof(magic)) == 0;
+    std::fclose(file);
+    return match;
+}
+
+} // namespace camerascalib
@@ -0,0 +1,130 @@
+#ifndef CAMERASCALIB_RECORDING_H
+#define CAMERASCALIB_RECORDING_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdio>
+
+#include "frame.h"
+
+namespace camerascalib {
+
+// On-disk layout of a recording. All fields are little endian, every entry
+// and every image starts on a record_alignment boundary so replay can wrap
+// the mapped file in cv::Mat headers without copying.
+//
+//   RecordFileHeader
+//   entry 0: RecordEntryHeader, RecordImageHeader x cameras, pixels x cameras
+//   entry 1: ...
+//   index: uint64_t entry offsets x entries (written on close)
+//
+// A recording cut short (no index) can still be replayed by walking the
+// entries through their size field.
+static const char record_magic[8] = { 'C', 'C', 'A', 'L', 'R', 'E', 'C', '1' };
+static const uint32_t record_entry_magic = 0x52494150;  // "PAIR"
+static const size_t record_alignment = 64;
+
+struct RecordFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t cameras;
+    uint64_t index_offset;  // 0 until the recording is closed
+    uint64_t entries;
+    uint8_t reserved[32];
+};
+
+struct RecordEntryHeader
+{
+    uint32_t magic;
+    uint32_t cameras;
+    uint64_t sequence;      // pair number in the recording
+    uint64_t size;          // whole entry, headers and padding included
+    uint64_t reserved;
+};
+
+struct RecordImageHeader
+{
+    int64_t timestamp;
+    uint64_t sequence;      // frame number of the camera
+    uint32_t format;        // PixelFormat
+    int32_t type;           // cv::Mat type
+    int32_t cols;
+    int32_t rows;
+    uint64_t stride;        // bytes per row
+    uint64_t offset;        // of the pixels from the start of the entry
+};
+
+// Appends synchronised frame sets to a recording from a writer thread. The
+// queue holds references to the captured buffers, so Append() copies nothing;
+// when the disk falls behind, sets are dropped rather than stalling capture.
+// After a failed write the partial entry is cut off and every later set is
+// dropped, so the recording stays readable up to the last complete entry.
+class RecordWriter
+{
+public:
+    explicit RecordWriter(size_t queue_size = 8);
+    ~RecordWriter();
+
+    bool Open(const std::string& path, int cameras);
+    void Close();
+
+    // Queue a set of frames, one per camera. Returns false if it was dropped.
+    bool Append(const std::vector<Frame>& frames);
+
+    unsigned long Written() const { return written_; }
+    unsigned long Dropped() const { return dropped_; }
+
+private:
+    void Run();
+    bool Write(const std::vector<Frame>& frames);
+
+    std::FILE* file_;
+    uint32_t cameras_;
+    uint64_t offset_;
+    std::vector<uint64_t> index_;
+
+    size_t queue_size_;
+    std::deque<std::vector<Frame>> queue_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool closing_;
+    std::atomic<bool> failed_;      // a write failed, nothing more is appended
+    std::thread thread_;
+    std::atomic<unsigned long> written_;
+    std::atomic<unsigned long> dropped_;
+};
+
+// Memory-maps a recording. Frames handed out point straight into the mapping
+// and stay valid as long as the reader is open.
+class RecordReader
+{
+public:
+    RecordReader();
+    ~RecordReader();
+
+    bool Open(const std::string& path);
+    void Close();
+
+    size_t Entries() const { return entries_.size(); }
+    int Cameras() const { return cameras_; }
+    bool Read(size_t entry, int camera, Frame& frame) const;
+
+    // True if the file starts like a recording
+    static bool IsRecording(const std::string& path);
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    int cameras_;
+    std::vector<uint64_t> entries_;
+};
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_RECORDING_H
@@ -0,0 +1,162 @@
+#include "replay_source.h"
+
+#include <sstream>
+#include <algorithm>
+
+#include <opencv2/core/utility.hpp>
+#include <opencv2/core/utils/filesystem.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+namespace camerascalib {
+
+static bool has_suffix(const std::string& str, const std::string& suffix)
+{
+    return str.size() >= suffix.size() &&
+        str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+ReplaySource::ReplaySource(int camera, const CaptureSettings& settings)
+    : camera_(camera)
+    , settings_(settings)
+    , fps_(settings.fps)
+    , format_(PIXEL_FORMAT_BGR)
+    , first_timestamp_(0)
+    , index_(0)
+    , start_(0)
+{
+}
+
+bool ReplaySource::Open()
+{
+    const std::string& source = settings_.replay;
+    std::vector<std::string> paths = SplitList(source);
+    if (paths.size() > 1) {
+        if (camera_ >= (int)paths.size()) {
+            return false;
+        }
+        const std::string& path = paths[camera_];
+        return cv::utils::fs::isDirectory(path) ? OpenImages(path) : OpenVideo(path);
+    }
+
+    if (cv::utils::fs::isDirectory(source)) {
+        return OpenImages(source + "/cam" + std::to_string(camera_));
+    }
+    if (RecordReader::IsRecording(source)) {
+        return OpenRecording(source);
+    }
+    return OpenContainer(source);
+}
+
+bool ReplaySource::OpenImages(const std::string& dir)
+{
+    std::vector<std::string> files;
+    cv::glob(dir + "/*", files, false);
+    files_.clear();
+    for (const std::string& file : files) {
+        if (has_suffix(file, ".png") || has_suffix(file, ".jpg") ||
+            has_suffix(file, ".bmp") || has_suffix(file, ".tiff")) {
+            files_.push_back(file);
+        }
+    }
+    std::sort(files_.begin(), files_.end());
+    description_ = dir;
+    return !files_.empty();
+}
+
+bool ReplaySource::OpenVideo(const std::string& path)
+{
+    if (!video_.open(path, cv::CAP_ANY)) {
+        return false;
+    }
+    double fps = video_.get(cv::CAP_PROP_FPS);
+    if (fps > 0) {
+        fps_ = fps;
+    }
+    description_ = path;
+    return true;
+}
+
+bool ReplaySource::OpenContainer(const std::string& path)
+{
+    std::string demux;
+    if (has_suffix(path, ".mkv") || has_suffix(path, ".webm")) {
+        demux = "matroskademux";
+    }
+    else if (has_suffix(path, ".mp4") || has_suffix(path, ".mov")) {
+        demux = "qtdemux";
+    }
+    else {
+        return false;
+    }
+
+    std::stringstream pipeline_str;
+    pipeline_str << "filesrc location=\"" << path << "\" ! " << demux
+        << " name=demux demux.video_" << camera_
+        << " ! queue ! decodebin ! videoconvert"
+        " ! video/x-raw, format=(string)BGR ! appsink sync=false ";
+    if (!video_.open(pipeline_str.str(), cv::CAP_GSTREAMER)) {
+        return false;
+    }
+    description_ = pipeline_str.str();
+    return true;
+}
+
+bool ReplaySource::OpenRecording(const std::string& path)
+{
+    Frame first;
+    if (!record_.Open(path) || !record_.Read(0, camera_, first)) {
+        return false;
+    }
+    format_ = first.format;
+    first_timestamp_ = first.timestamp;
+    description_ = path + " (" + std::to_string(record_.Entries()) + " pairs)";
+    return true;
+}
+
+bool ReplaySource::Read(Frame& frame)
+{
+    if (record_.Entries() > 0) {
+        // zero-copy: the frame points into the mapped file, timestamps are
+        // the ones captured
+        if (!record_.Read(index_++, camera_, frame)) {
+            return false;
+        }
+        if (settings_.pacing == PACING_REALTIME) {
+            PaceFrame(start_, frame.timestamp - first_timestamp_);
+        }
+        return true;
+    }
+
+    if (!files_.empty()) {
+        if (index_ >= files_.size()) {
+            return false;
+        }
+        frame.image = cv::imread(files_[index_], cv::IMREAD_COLOR);
+    }
+    else if (!video_.read(frame.image)) {
+        return false;
+    }
+    if (frame.image.empty()) {
+        return false;
+    }
+
+    // the recorded position is the timestamp, so pairs match by index
+    int64_t period = (int64_t)(1e9 / fps_);
+    frame.timestamp = (int64_t)index_ * period;
+    frame.sequence = index_++;
+    frame.format = NativeFormat();
+
+    if (settings_.pacing == PACING_REALTIME) {
+        PaceFrame(start_, frame.timestamp);
+    }
+    return true;
+}
+
+void ReplaySource::Close()
+{
+    video_.release();
+    files_.clear();
+    record_.Close();
+}
+
+} // namespace camerascalib
@@ -0,0 +1,56 @@
+#ifndef CAMERASCALIB_REPLAY_SOURCE_H
+#define CAMERASCALIB_REPLAY_SOURCE_H
+
+#include <string>
+#include <vector>
+
+#include <opencv2/videoio/videoio.hpp>
+
+#include "capture_source.h"
+#include "recording.h"
+
+namespace camerascalib {
+
+// Reads one camera of a recorded stereo session. A replay source is one of
+//   left.mp4,right.mp4   two video files (or two image directories)
+//   session/             a directory with cam0/ and cam1/ image sequences
+//   session.mkv          a container with one video track per camera
+//   session.rec          a raw recording made with --record, memory-mapped
+// Frames are stamped with their recorded position, so the two cameras of a
+// recording pair up exactly regardless of how fast they are decoded.
+class ReplaySource : public CaptureSource
+{
+public:
+    ReplaySource(int camera, const CaptureSettings& settings);
+
+    bool Open() override;
+    bool Read(Frame& frame) override;
+    void Close() override;
+
+    PixelFormat NativeFormat() const override { return format_; }
+    bool Live() const override { return settings_.pacing == PACING_REALTIME; }
+    std::string Description() const override { return description_; }
+
+private:
+    bool OpenImages(const std::string& dir);
+    bool OpenVideo(const std::string& path);
+    bool OpenContainer(const std::string& path);
+    bool OpenRecording(const std::string& path);
+
+    int camera_;
+    CaptureSettings settings_;
+    double fps_;
+    std::string description_;
+    PixelFormat format_;
+
+    cv::VideoCapture video_;
+    std::vector<std::string> files_;
+    RecordReader record_;
+    int64_t first_timestamp_;
+    uint64_t index_;
+    int64_t start_;
+};
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_REPLAY_SOURCE_H
@@ -0,0 +1,239 @@
+#include "rig_calibrator.h"
+
+#include <iostream>
+#include <algorithm>
+
+#include <opencv2/core/utility.hpp>
+
+#include "matching.h"
+#include "evaluation.h"
+#include "ransac.h"
+
+namespace camerascalib {
+
+static const size_t min_inliers = 30;          // for a camera pair to count as overlapping
+static const size_t max_edge_points = 500;     // inliers per pair taken into the refinement
+
+RigCalibrator::RigCalibrator(const Settings& settings)
+    : settings_(settings)
+    , cache_(4, settings.cameras, settings.cameras * (settings.cameras - 1) / 2)
+    , transforms_(settings.cameras, cv::Matx33d::eye())
+    , calibrated_(settings.cameras, false)
+    , evaluators_(settings.cameras, PairEvaluator(settings.eval_level))
+{
+    if (settings_.full_size.area() == 0) {
+        settings_.full_size = settings_.image_size;
+    }
+    calibrated_[0] = true;
+    CorrespondenceStore::Settings store_settings;
+    store_settings.capacity = settings_.max_correspondences;
+    for (int i = 0; i < settings_.cameras; i++)
+    {
+        detectors_.push_back(CreateDetector(settings_.match_mode, settings_.detector));
+        for (int j = i + 1; j < settings_.cameras; j++) {
+            pairs_.push_back(CameraPair{ i, j,
+                CorrespondenceStore(store_settings, settings_.image_size) });
+        }
+    }
+    matcher_ = cv::BFMatcher::create(detectors_[0]->defaultNorm());
+}
+
+const PairFeatures& RigCalibrator::Features(const std::vector<cv::Mat>& images, uint64_t sequence)
+{
+    const PairFeatures* cached = cache_.Find(sequence);
+    if (cached) {
+        return *cached;
+    }
+    PairFeatures& features = cache_.Insert(sequence);
+    cv::parallel_for_(cv::Range(0, settings_.cameras), [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; i++) {
+            cv::Mat gray;
+            ToGray(images[i], gray);
+            detectors_[i]->detectAndCompute(gray, cv::noArray(),
+                features.keypoints[i], features.descriptors[i]);
+        }
+    });
+    cv::parallel_for_(cv::Range(0, (int)pairs_.size()), [&](const cv::Range& range) {
+        for (int p = range.start; p < range.end; p++) {
+            RatioMatch(*matcher_, features.descriptors[pairs_[p].from],
+                features.descriptors[pairs_[p].to], features.matches[p]);
+        }
+    });
+    return features;
+}
+
+void RigCalibrator::Feed(cv::InputArrayOfArrays images, uint64_t sequence)
+{
+    std::vector<cv::Mat> set;
+    images.getMatVector(set);
+
+    const PairFeatures& features = Features(set, sequence);
+    for (size_t p = 0; p < pairs_.size(); p++)
+    {
+        CameraPair& pair = pairs_[p];
+        for (const cv::DMatch& match : features.matches[p]) {
+            pair.points.Offer(features.keypoints[pair.from][match.queryIdx].pt,
+                features.keypoints[pair.to][match.trainIdx].pt, -match.distance);
+        }
+    }
+}
+
+void RigCalibrator::Matches(const std::vector<cv::Mat>& images, uint64_t sequence,
+    cv::Mat& matches_image)
+{
+    const PairFeatures& features = Features(images, sequence);
+    size_t best = 0;
+    for (size_t p = 1; p < pairs_.size(); p++) {
+        if (features.matches[p].size() > features.matches[best].size()) {
+            best = p;
+        }
+    }
+    int from = pairs_[best].from;
+    int to = pairs_[best].to;
+    cv::drawMatches(images[from], features.keypoints[from], images[to], features.keypoints[to],
+        features.matches[best], matches_image);
+}
+
+void RigCalibrator::Evaluate(cv::InputArrayOfArrays images, double& psnr, cv::Scalar& mssim,
+    cv::OutputArray stitched_image)
+{
+    std::vector<cv::Mat> set;
+    images.getMatVector(set);
+    const cv::Mat& base = set[0];
+
+    cv::Mat stitched;
+    if (stitched_image.needed()) {
+        stitched_image.create(base.size(), base.type());
+        stitched = stitched_image.getMat();
+        base.copyTo(stitched);
+    }
+
+    int scored = 0;
+    double psnr_sum = 0;
+    cv::Scalar mssim_sum;
+    for (int c = 1; c < settings_.cameras; c++)
+    {
+        if (!calibrated_[c]) {
+            continue;
+        }
+        cv::Matx33d transform = ScaleHomography(transforms_[c], settings_.image_size, base.size());
+        double camera_psnr;
+        cv::Scalar camera_mssim;
+        if (!evaluators_[c].Score(base, set[c], transform, camera_psnr, camera_mssim)) {
+            continue;
+        }
+        psnr_sum += camera_psnr;
+        mssim_sum += camera_mssim;
+        scored++;
+        if (!stitched.empty()) {
+            evaluators_[c].Blend(set[c], transform, stitched);
+        }
+    }
+    psnr = scored > 0 ? psnr_sum / scored : 0;
+    mssim = scored > 0 ? mssim_sum * (1.0 / scored) : cv::Scalar();
+}
+
+bool RigCalibrator::Estimate()
+{
+    // every camera pair on its own first, in parallel
+    std::vector<PoseEdge> edges(pairs_.size());
+    std::vector<uchar> overlapping(pairs_.size(), 0);
+    cv::parallel_for_(cv::Range(0, (int)pairs_.size()), [&](const cv::Range& range) {
+        for (int p = range.start; p < range.end; p++)
+        {
+            const CameraPair& pair = pairs_[p];
+            const Correspondences& points = pair.points.Points();
+            if (points.Size() < min_inliers) {
+                continue;
+            }
+            std::vector<uchar> mask;
+            cv::Matx33d transform;
+            bool found = FindHomographyRansac(points, RansacSettings(), transform, &mask);
+            size_t inliers = found ? (size_t)cv::countNonZero(mask) : 0;
+            if (inliers < min_inliers || inliers < points.Size() / 10) {
+                continue;
+            }
+
+            PoseEdge& edge = edges[p];
+            edge.from = pair.from;
+            edge.to = pair.to;
+            edge.transform = transform;
+            // an evenly spread subset keeps the refinement cheap
+            size_t stride = std::max<size_t>(1, inliers / max_edge_points);
+            size_t n = 0;
+            for (size_t k = 0; k < mask.size(); k++) {
+                if (mask[k] && n++ % stride == 0) {
+                    edge.points_from.push_back(points.Point0(k));
+                    edge.points_to.push_back(points.Point1(k));
+                }
+            }
+            overlapping[p] = 1;
+        }
+    });
+
+    PoseGraph graph(settings_.cameras, settings_.image_size);
+    for (size_t p = 0; p < pairs_.size(); p++) {
+        if (overlapping[p]) {
+            std::cout << "Cameras " << pairs_[p].from << "-" << pairs_[p].to << ": "
+                << edges[p].points_from.size() << " inliers used" << std::endl;
+            graph.AddEdge(edges[p]);
+        }
+    }
+    if (!graph.Initialise()) {
+        std::cerr << "Not every camera overlaps the rig yet, keep feeding" << std::endl;
+    }
+
+    double initial_rms = 0, final_rms = 0;
+    graph.Refine(50, initial_rms, final_rms);
+    std::cout << "Rig refined over " << graph.Edges().size() << " camera pairs, transfer error "
+        << initial_rms << " -> " << final_rms << " px RMS" << std::endl;
+
+    bool any = false;
+    for (int c = 1; c < settings_.cameras; c++)
+    {
+        calibrated_[c] = graph.Connected(c);
+        if (calibrated_[c]) {
+            transforms_[c] = graph.Transform(c);
+            std::cout << "Camera " << c << ":\n" << cv::Mat(transforms_[c]) << std::endl;
+            any = true;
+        }
+    }
+    return any;
+}
+
+bool RigCalibrator::Save()
+{
+    cv::FileStorage fs(settings_.calib_file, cv::FileStorage::WRITE);
+    if (!fs.isOpened()) {
+        std::cerr << "Failed to write " << settings_.calib_file << std::endl;
+        return false;
+    }
+    fs << "cameras" << settings_.cameras;
+    fs << "image_size" << settings_.full_size;
+    // camera 0 to each camera, camera 0 itself included
+    fs << "transforms" << "[";
+    for (int c = 0; c < settings_.cameras; c++) {
+        fs << cv::Mat(ScaleHomography(transforms_[c], settings_.image_size, settings_.full_size));
+    }
+    fs << "]";
+    fs << "calibrated" << "[";
+    for (int c = 0; c < settings_.cameras; c++) {
+        fs << (int)calibrated_[c];
+    }
+    fs << "]";
+    std::cout << "Saved " << settings_.cameras << " transforms to " << settings_.calib_file
+        << std::endl;
+    return true;
+}
+
+void RigCalibrator::Reset()
+{
+    for (CameraPair& pair : pairs_) {
+        pair.points.Clear();
+    }
+    transforms_.assign(settings_.cameras, cv::Matx33d::eye());
+    calibrated_.assign(settings_.cameras, false);
+    calibrated_[0] = true;
+}
+
+} // namespace camerascalib
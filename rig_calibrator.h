@@ -0,0 +1,62 @@
+#ifndef CAMERASCALIB_RIG_CALIBRATOR_H
+#define CAMERASCALIB_RIG_CALIBRATOR_H
+
+#include <opencv2/features2d.hpp>
+
+#include "calibrator.h"
+#include "correspondence_store.h"
+#include "feature_cache.h"
+#include "pose_graph.h"
+#include "evaluation.h"
+
+namespace camerascalib {
+
+// Calibrator for rigs of more than two cameras, on host images. Features are
+// detected once per camera and every camera pair is matched, all in
+// parallel, since which cameras overlap is not known up front. Estimate fits
+// each pair with RANSAC, keeps the pairs with enough inliers as edges of a
+// PoseGraph and refines the transforms of all cameras together, so they are
+// consistent across the rig. The calibration file holds one transform per
+// camera, from camera 0.
+class RigCalibrator : public Calibrator
+{
+public:
+    explicit RigCalibrator(const Settings& settings);
+
+    bool OnGpu() const override { return false; }
+    bool FullSizeEvaluate() const override { return true; }
+
+    void Feed(cv::InputArrayOfArrays images, uint64_t sequence) override;
+    // Draws the camera pair with the most matches in this set
+    void Matches(const std::vector<cv::Mat>& images, uint64_t sequence,
+        cv::Mat& matches_image) override;
+    // Every calibrated camera warped onto camera 0, scored over the overlaps
+    void Evaluate(cv::InputArrayOfArrays images, double& psnr, cv::Scalar& mssim,
+        cv::OutputArray stitched_image) override;
+    bool Estimate() override;
+    bool Save() override;
+    void Reset() override;
+
+private:
+    struct CameraPair
+    {
+        int from;
+        int to;
+        CorrespondenceStore points;     // bucketed over camera from
+    };
+
+    const PairFeatures& Features(const std::vector<cv::Mat>& images, uint64_t sequence);
+
+    Settings settings_;
+    std::vector<cv::Ptr<cv::Feature2D>> detectors_;    // one per camera, so all run at once
+    cv::Ptr<cv::DescriptorMatcher> matcher_;
+    std::vector<CameraPair> pairs_;
+    FeatureCache cache_;
+    std::vector<cv::Matx33d> transforms_;               // camera 0 to camera, at image_size
+    std::vector<bool> calibrated_;
+    std::vector<PairEvaluator> evaluators_;             // per camera, onto camera 0
+};
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_RIG_CALIBRATOR_H
@@ -0,0 +1,110 @@
+#ifndef CAMERASCALIB_SPSC_QUEUE_H
+#define CAMERASCALIB_SPSC_QUEUE_H
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+namespace camerascalib {
+
+// Bounded lock-free queue between exactly one producer thread and one
+// consumer thread. Waiting is done by spinning briefly and then sleeping in
+// short steps, so an idle stage costs next to nothing and a busy one never
+// takes a lock.
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(size_t capacity)
+        : capacity_(capacity > 0 ? capacity : 1)
+        , head_(0)
+        , tail_(0)
+    {
+        size_t slots = 1;
+        while (slots < capacity_) {
+            slots <<= 1;
+        }
+        slots_.resize(slots);
+        mask_ = slots - 1;
+    }
+
+    bool TryPush(const T& item)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) >= capacity_) {
+            return false;
+        }
+        slots_[tail & mask_] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T& item)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = slots_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Wait for room until stop is raised
+    bool Push(const T& item, const std::atomic<bool>& stop)
+    {
+        for (int spins = 0; !stop; spins++) {
+            if (TryPush(item)) {
+                return true;
+            }
+            Backoff(spins);
+        }
+        return false;
+    }
+
+    // Wait for an item until stop is raised or timeout_ms has passed
+    bool Pop(T& item, const std::atomic<bool>& stop, int timeout_ms)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        for (int spins = 0; !stop; spins++) {
+            if (TryPop(item)) {
+                return true;
+            }
+            if (std::chrono::steady_clock::now() >= deadline) {
+                break;
+            }
+            Backoff(spins);
+        }
+        return false;
+    }
+
+    bool Empty() const
+    {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+private:
+    static void Backoff(int spins)
+    {
+        if (spins < 64) {
+            std::this_thread::yield();
+        }
+        else {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+
+    std::vector<T> slots_;
+    size_t capacity_;
+    size_t mask_;
+    // producer and consumer indices on separate cache lines
+    char pad0_[64];
+    std::atomic<size_t> head_;
+    char pad1_[64];
+    std::atomic<size_t> tail_;
+};
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_SPSC_QUEUE_H
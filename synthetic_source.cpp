@@ -0,0 +1,218 @@
+#include "synthetic_source.h"
+
+#include <cmath>
+#include <algorithm>
+#include <mutex>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace camerascalib {
+
+// largest scene rendered, per side
+static const int max_scene_size = 16384;
+
+// Smooth random texture with sharp shapes on top, so detectors find corners
+// at every scale. The seed is fixed: every run sees the same scene.
+static cv::Mat render_scene(cv::Size size)
+{
+    cv::RNG rng(0x5eed);
+
+    cv::Mat coarse(std::max(size.height / 32, 2), std::max(size.width / 32, 2), CV_8UC3);
+    rng.fill(coarse, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(255));
+    cv::Mat scene;
+    cv::resize(coarse, scene, size, 0, 0, cv::INTER_CUBIC);
+
+    int shapes = size.area() / 4000;
+    for (int i = 0; i < shapes; i++)
+    {
+        cv::Point center(rng.uniform(0, size.width), rng.uniform(0, size.height));
+        int radius = rng.uniform(4, 40);
+        cv::Scalar color(rng.uniform(0, 255), rng.uniform(0, 255), rng.uniform(0, 255));
+        if (i % 2) {
+            cv::circle(scene, center, radius, color, cv::FILLED);
+        }
+        else {
+            cv::rectangle(scene, cv::Rect(center.x, center.y, radius, radius * 2), color,
+                cv::FILLED);
+        }
+    }
+    return scene;
+}
+
+// All cameras look at the same scene, so it is rendered once per scene size
+static cv::Mat shared_scene(cv::Size size)
+{
+    static std::mutex mutex;
+    static cv::Mat scene;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (scene.empty() || scene.size() != size) {
+        scene = render_scene(size);
+    }
+    return scene;
+}
+
+static cv::Matx33d translation(double x, double y)
+{
+    return cv::Matx33d(1, 0, x, 0, 1, y, 0, 0, 1);
+}
+
+static bool project(const cv::Matx33d& h, const cv::Point2d& p, cv::Point2d& q)
+{
+    double w = h(2, 0) * p.x + h(2, 1) * p.y + h(2, 2);
+    if (w <= 1e-9) {
+        return false;
+    }
+    q.x = (h(0, 0) * p.x + h(0, 1) * p.y + h(0, 2)) / w;
+    q.y = (h(1, 0) * p.x + h(1, 1) * p.y + h(1, 2)) / w;
+    return true;
+}
+
+static std::vector<cv::Point2d> image_corners(cv::Size size)
+{
+    std::vector<cv::Point2d> corners;
+    corners.push_back(cv::Point2d(0, 0));
+    corners.push_back(cv::Point2d(size.width, 0));
+    corners.push_back(cv::Point2d(size.width, size.height));
+    corners.push_back(cv::Point2d(0, size.height));
+    return corners;
+}
+
+cv::Matx33d SyntheticSettings::Homography(int camera, cv::Size size) const
+{
+    double angle = rot * M_PI / 180.0;
+    double c = std::cos(angle) * scale;
+    double s = std::sin(angle) * scale;
+    cv::Matx33d rotation(c, -s, 0, s, c, 0, 0, 0, 1);
+    cv::Matx33d perspective(1, 0, 0, 0, 1, 0, px, py, 1);
+    cv::Matx33d center = translation(size.width / 2.0, size.height / 2.0);
+    cv::Matx33d step = translation(tx, ty) * center * rotation * perspective *
+        translation(-size.width / 2.0, -size.height / 2.0);
+
+    cv::Matx33d h = cv::Matx33d::eye();
+    for (int i = 0; i < camera; i++) {
+        h = step * h;
+    }
+    return h;
+}
+
+bool ParseSyntheticSettings(const std::string& spec, cv::Size size,
+    SyntheticSettings& settings)
+{
+    settings = SyntheticSettings();
+    settings.tx = -0.4 * size.width;
+
+    if (!ParseKeyValues<double>(spec, {
+            { "tx", &settings.tx }, { "ty", &settings.ty },
+            { "rot", &settings.rot }, { "scale", &settings.scale },
+            { "px", &settings.px }, { "py", &settings.py },
+            { "noise", &settings.noise }, { "blur", &settings.blur },
+            { "gain", &settings.gain }, { "bias", &settings.bias },
+        })) {
+        return false;
+    }
+    return settings.scale > 0 && settings.noise >= 0 && settings.blur >= 0;
+}
+
+SyntheticSource::SyntheticSource(int camera, const CaptureSettings& settings)
+    : camera_(camera)
+    , settings_(settings)
+    , index_(0)
+    , start_(0)
+{
+}
+
+bool SyntheticSource::Open()
+{
+    const cv::Size& size = settings_.size;
+    if (!ParseSyntheticSettings(settings_.synthetic, size, synthetic_)) {
+        return false;
+    }
+    homography_ = synthetic_.Homography(camera_, size);
+
+    // bounding box of every camera's view in camera 0 coordinates, plus the
+    // pan range, decides the extent of the scene
+    double min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+    for (int c = 0; c < std::max(settings_.cameras, camera_ + 1); c++)
+    {
+        cv::Matx33d inverse = synthetic_.Homography(c, size).inv();
+        for (const cv::Point2d& corner : image_corners(size))
+        {
+            cv::Point2d p;
+            if (!project(inverse, corner, p)) {
+                return false;
+            }
+            min_x = std::min(min_x, p.x);
+            min_y = std::min(min_y, p.y);
+            max_x = std::max(max_x, p.x);
+            max_y = std::max(max_y, p.y);
+        }
+    }
+    max_x += size.width / 8.0;
+    max_y += size.height / 8.0;
+    if (max_x - min_x > max_scene_size || max_y - min_y > max_scene_size) {
+        return false;
+    }
+
+    origin_ = cv::Point2d(-min_x, -min_y);
+    scene_ = shared_scene(cv::Size(cvCeil(max_x - min_x), cvCeil(max_y - min_y)));
+    return !scene_.empty();
+}
+
+bool SyntheticSource::Read(Frame& frame)
+{
+    const cv::Size& size = settings_.size;
+    int64_t period = 1000000000LL / settings_.fps;
+
+    // slow circular pan, identical for all cameras so they stay in sync
+    double phase = 2 * M_PI * (double)index_ / (settings_.fps * 10.0);
+    double pan_x = (1 + std::cos(phase)) * size.width / 16;
+    double pan_y = (1 + std::sin(phase)) * size.height / 16;
+
+    // scene to camera 0, then on to this camera
+    cv::Matx33d view = homography_ * translation(-origin_.x - pan_x, -origin_.y - pan_y);
+    cv::Mat bgr;
+    cv::warpPerspective(scene_, bgr, cv::Mat(view), size, cv::INTER_LINEAR,
+        cv::BORDER_CONSTANT);
+
+    if (camera_ > 0) {
+        if (synthetic_.blur > 0) {
+            cv::GaussianBlur(bgr, bgr, cv::Size(0, 0), synthetic_.blur);
+        }
+        if (synthetic_.gain != 1.0 || synthetic_.bias != 0) {
+            bgr.convertTo(bgr, -1, synthetic_.gain, synthetic_.bias);
+        }
+    }
+    if (synthetic_.noise > 0) {
+        // seeded per camera and frame, so every run is identical
+        cv::RNG rng(((uint64_t)camera_ << 32) ^ index_);
+        cv::Mat noise(size, CV_16SC3);
+        rng.fill(noise, cv::RNG::NORMAL, cv::Scalar::all(0), cv::Scalar::all(synthetic_.noise));
+        cv::add(bgr, noise, bgr, cv::noArray(), CV_8U);
+    }
+
+    if (settings_.format == PIXEL_FORMAT_BGR) {
+        frame.image = bgr;
+    }
+    else {
+        FromBgr(bgr, settings_.format, frame.image);
+    }
+
+    frame.timestamp = (int64_t)index_ * period;
+    frame.sequence = index_++;
+    frame.format = NativeFormat();
+
+    if (settings_.pacing == PACING_REALTIME) {
+        PaceFrame(start_, frame.timestamp);
+    }
+    return true;
+}
+
+std::string SyntheticSource::Description() const
+{
+    return "synthetic camera " + std::to_string(camera_) + " " +
+        std::to_string(settings_.size.width) + "x" + std::to_string(settings_.size.height) +
+        "@" + std::to_string(settings_.fps);
+}
+
+} // namespace camerascalib
@@ -0,0 +1,63 @@
+#ifndef CAMERASCALIB_SYNTHETIC_SOURCE_H
+#define CAMERASCALIB_SYNTHETIC_SOURCE_H
+
+#include "capture_source.h"
+
+namespace camerascalib {
+
+// Ground truth and image degradations of the synthetic rig, parsed from a
+// comma separated key=value list, e.g. "tx=-700,rot=1.5,noise=2,gain=1.2".
+// Camera c sees camera c-1's view mapped through the homography
+//     H = T(tx, ty) * R(rot, scale) * P(px, py)
+// taken about the image centre, so camera 1 relative to camera 0 is exactly H.
+struct SyntheticSettings
+{
+    double tx = 0;          // translation in pixels [Default = -40% of the width]
+    double ty = 0;
+    double rot = 1.0;       // rotation in degrees
+    double scale = 1.0;
+    double px = 0;          // perspective terms, in 1/pixels
+    double py = 0;
+    double noise = 0;       // standard deviation of additive gaussian noise, all cameras
+    double blur = 0;        // gaussian blur sigma, cameras other than the reference
+    double gain = 1.0;      // exposure difference, cameras other than the reference
+    double bias = 0;
+
+    // Transform from camera 0 image coordinates to camera image coordinates
+    cv::Matx33d Homography(int camera, cv::Size size) const;
+};
+
+bool ParseSyntheticSettings(const std::string& spec, cv::Size size,
+    SyntheticSettings& settings);
+
+// Renders a textured scene that slowly pans and shows each camera of the rig
+// its view through the known homographies, with optional noise, blur and
+// exposure differences, at any resolution and frame rate. Every run renders
+// the same frames, so it serves both for throughput benchmarks and for
+// accuracy checks of the estimated transform.
+class SyntheticSource : public CaptureSource
+{
+public:
+    SyntheticSource(int camera, const CaptureSettings& settings);
+
+    bool Open() override;
+    bool Read(Frame& frame) override;
+
+    PixelFormat NativeFormat() const override { return settings_.format; }
+    bool Live() const override { return settings_.pacing == PACING_REALTIME; }
+    std::string Description() const override;
+
+private:
+    int camera_;
+    CaptureSettings settings_;
+    SyntheticSettings synthetic_;
+    cv::Matx33d homography_;
+    cv::Point2d origin_;    // scene position of camera 0's view before panning
+    cv::Mat scene_;
+    uint64_t index_;
+    int64_t start_;
+};
+
+} // namespace camerascalib
+
+#endif // CAMERASCALIB_SYNTHETIC_SOURCE_H